@@ -0,0 +1,115 @@
+//
+//  BlockQueue.hpp
+//  CrackList
+//
+//  Created by Kryc on 16/10/2026.
+//  Copyright © 2026 Kryc. All rights reserved.
+//
+
+#ifndef BlockQueue_hpp
+#define BlockQueue_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// A bounded queue for any number of producers and consumers. Both
+// sides wait on a condition variable rather than polling, so a
+// consumer is woken as soon as an item is pushed and a producer as
+// soon as there is space. Closing wakes everyone, consumers still
+// take what is left before seeing the end
+template <typename T>
+class BlockQueue
+{
+public:
+    BlockQueue(const size_t Capacity) : m_Capacity(Capacity) {}
+    // Waits for space, false if the queue is closed
+    const bool Push(
+        T&& Item
+    )
+    {
+        std::unique_lock<std::mutex> lock(m_Lock);
+        m_NotFull.wait(lock, [this]{ return m_Items.size() < m_Capacity || m_Closed; });
+        if (m_Closed)
+        {
+            return false;
+        }
+        m_Items.push_back(std::move(Item));
+        lock.unlock();
+        m_NotEmpty.notify_one();
+        return true;
+    }
+    // Waits for an item, false once the queue is closed and empty
+    const bool Pop(
+        T& Item
+    )
+    {
+        std::unique_lock<std::mutex> lock(m_Lock);
+        m_NotEmpty.wait(lock, [this]{ return !m_Items.empty() || m_Closed; });
+        if (m_Items.empty())
+        {
+            return false;
+        }
+        Item = std::move(m_Items.front());
+        m_Items.pop_front();
+        lock.unlock();
+        m_NotFull.notify_one();
+        return true;
+    }
+    // Never waits, false if the queue is full or closed
+    const bool TryPush(
+        T&& Item
+    )
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Lock);
+            if (m_Items.size() >= m_Capacity || m_Closed)
+            {
+                return false;
+            }
+            m_Items.push_back(std::move(Item));
+        }
+        m_NotEmpty.notify_one();
+        return true;
+    }
+    // Never waits, false if the queue is empty
+    const bool TryPop(
+        T& Item
+    )
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Lock);
+            if (m_Items.empty())
+            {
+                return false;
+            }
+            Item = std::move(m_Items.front());
+            m_Items.pop_front();
+        }
+        m_NotFull.notify_one();
+        return true;
+    }
+    void Close(void)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Lock);
+            m_Closed = true;
+        }
+        m_NotEmpty.notify_all();
+        m_NotFull.notify_all();
+    }
+    const bool IsClosed(void)
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        return m_Closed;
+    }
+private:
+    const size_t m_Capacity;
+    std::mutex m_Lock;
+    std::condition_variable m_NotEmpty;
+    std::condition_variable m_NotFull;
+    std::deque<T> m_Items;
+    bool m_Closed = false;
+};
+
+#endif /* BlockQueue_hpp */
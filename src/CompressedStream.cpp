@@ -0,0 +1,600 @@
+//
+//  CompressedStream.cpp
+//  CrackTools
+//
+//  Created by Kryc on 16/10/2026.
+//  Copyright © 2026 Kryc. All rights reserved.
+//
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <thread>
+
+#include <zlib.h>
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "CompressedStream.hpp"
+#include "UnsafeBuffer.hpp"
+
+// The size of each decompressed block and how many
+// are held ahead of the reader
+#define DECOMPRESS_BLOCK_SIZE (1 << 20)
+#define DECOMPRESS_BLOCKS_AHEAD 8
+// Compressed bytes read from the file at a time
+#define DECOMPRESS_INPUT_SIZE (1 << 17)
+// Zstd frames up to this size are decompressed whole, on
+// up to this many threads
+#define DECOMPRESS_ZSTD_FRAME_LIMIT (16 << 20)
+#define DECOMPRESS_ZSTD_THREADS 4
+
+#ifdef HAVE_ZSTD
+// A zstd frame being decompressed by the pool
+typedef struct _ZstdFrame
+{
+    std::span<const uint8_t> input;
+    std::vector<char> output;
+    bool done = false;
+    bool failed = false;
+} ZstdFrame;
+#endif
+
+/* static */ const Compression
+CompressedStream::Detect(
+    const std::filesystem::path& Path
+)
+{
+    std::array<uint8_t, 6> magic = {};
+    FILE* file = fopen(Path.c_str(), "rb");
+    if (file == nullptr)
+    {
+        return CompressionNone;
+    }
+    const size_t read = fread(magic.data(), 1, magic.size(), file);
+    fclose(file);
+
+    if (read >= 2 && magic[0] == 0x1f && magic[1] == 0x8b)
+    {
+        return CompressionGzip;
+    }
+    if (read >= 6 && memcmp(magic.data(), "\xfd" "7zXZ\0", 6) == 0)
+    {
+        return CompressionXz;
+    }
+    if (read >= 4 && memcmp(magic.data(), "\x28\xb5\x2f\xfd", 4) == 0)
+    {
+        return CompressionZstd;
+    }
+    return CompressionNone;
+}
+
+const bool
+CompressedStream::Open(
+    const std::filesystem::path& Path
+)
+{
+    if (!m_Buffer.Open(Path, Detect(Path)))
+    {
+        setstate(std::ios::failbit);
+        return false;
+    }
+    rdbuf(&m_Buffer);
+    clear();
+    return true;
+}
+
+const bool
+DecompressBuffer::Open(
+    const std::filesystem::path& Path,
+    const Compression Type
+)
+{
+    switch (Type)
+    {
+    case CompressionGzip:
+        break;
+    case CompressionXz:
+#ifndef HAVE_LZMA
+        std::cerr << "Error: built without xz support" << std::endl;
+        return false;
+#endif
+        break;
+    case CompressionZstd:
+#ifndef HAVE_ZSTD
+        std::cerr << "Error: built without zstd support" << std::endl;
+        return false;
+#endif
+        break;
+    default:
+        std::cerr << "Error: " << Path << " is not a compressed file" << std::endl;
+        return false;
+    }
+
+    m_File = fopen(Path.c_str(), "rb");
+    if (m_File == nullptr)
+    {
+        std::cerr << "Error: unable to open " << Path << std::endl;
+        return false;
+    }
+
+    m_Path = Path;
+    m_Compression = Type;
+    m_Done = false;
+    m_Closing = false;
+    m_Failed = false;
+
+    m_Dispatcher = dispatch::CreateDispatcher(
+        "decompress",
+        dispatch::bind(
+            &DecompressBuffer::Decompress,
+            this
+        )
+    );
+
+    return true;
+}
+
+void
+DecompressBuffer::Close(
+    void
+)
+{
+    if (m_File == nullptr)
+    {
+        return;
+    }
+
+    // Wake the decompressor if it is waiting for
+    // space so it sees the close and finishes
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_Closing = true;
+    }
+    m_Changed.notify_all();
+    m_Dispatcher->Wait();
+    m_Dispatcher = nullptr;
+
+    fclose(m_File);
+    m_File = nullptr;
+    m_Blocks.clear();
+    m_Current.clear();
+    setg(nullptr, nullptr, nullptr);
+}
+
+const bool
+DecompressBuffer::Failed(
+    void
+)
+{
+    std::lock_guard<std::mutex> lock(m_Lock);
+    return m_Failed;
+}
+
+DecompressBuffer::int_type
+DecompressBuffer::underflow(
+    void
+)
+{
+    if (gptr() < egptr())
+    {
+        return traits_type::to_int_type(*gptr());
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(m_Lock);
+        m_Changed.wait(lock, [this]{ return !m_Blocks.empty() || m_Done; });
+
+        if (m_Blocks.empty())
+        {
+            return traits_type::eof();
+        }
+
+        m_Current = std::move(m_Blocks.front());
+        m_Blocks.pop_front();
+    }
+    m_Changed.notify_all();
+
+    setg(m_Current.data(), m_Current.data(), m_Current.data() + m_Current.size());
+    return traits_type::to_int_type(*gptr());
+}
+
+const bool
+DecompressBuffer::Emit(
+    std::vector<char>& Block,
+    const size_t Length
+)
+{
+    if (Length > 0)
+    {
+        Block.resize(Length);
+
+        std::unique_lock<std::mutex> lock(m_Lock);
+        m_Changed.wait(lock, [this]{ return m_Blocks.size() < DECOMPRESS_BLOCKS_AHEAD || m_Closing; });
+        if (m_Closing)
+        {
+            return false;
+        }
+        m_Blocks.push_back(std::move(Block));
+        lock.unlock();
+        m_Changed.notify_all();
+    }
+
+    Block = std::vector<char>(DECOMPRESS_BLOCK_SIZE);
+    return true;
+}
+
+void
+DecompressBuffer::Decompress(
+    void
+)
+{
+    bool result = false;
+    switch (m_Compression)
+    {
+    case CompressionGzip:
+        result = DecompressGzip();
+        break;
+    case CompressionXz:
+        result = DecompressXz();
+        break;
+    case CompressionZstd:
+        result = DecompressZstd();
+        break;
+    default:
+        break;
+    }
+
+    // The reader sees the end of the stream once it has taken every
+    // block, including after an error. Stopping because the buffer
+    // was closed early is not a failure
+    {
+        std::lock_guard<std::mutex> lock(m_Lock);
+        m_Done = true;
+        m_Failed = !result && !m_Closing;
+    }
+    m_Changed.notify_all();
+
+    dispatch::CurrentQueue()->Stop();
+}
+
+const bool
+DecompressBuffer::DecompressGzip(
+    void
+)
+{
+    std::vector<uint8_t> input(DECOMPRESS_INPUT_SIZE);
+    std::vector<char> block(DECOMPRESS_BLOCK_SIZE);
+    z_stream stream = {};
+
+    // Accept a zlib or gzip header
+    if (inflateInit2(&stream, 15 + 32) != Z_OK)
+    {
+        std::cerr << "Error: unable to initialize zlib" << std::endl;
+        return false;
+    }
+
+    stream.next_out = (Bytef*)block.data();
+    stream.avail_out = block.size();
+
+    bool eof = false;
+    bool inMember = false;
+    bool result = true;
+    while (result)
+    {
+        if (stream.avail_in == 0 && !eof)
+        {
+            stream.avail_in = fread(input.data(), 1, input.size(), m_File);
+            stream.next_in = input.data();
+            eof = stream.avail_in == 0;
+        }
+
+        const int ret = inflate(&stream, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END)
+        {
+            // Files such as those written by pigz can hold
+            // several gzip members back to back
+            inflateReset(&stream);
+            inMember = false;
+        }
+        else if (ret == Z_OK)
+        {
+            inMember = true;
+        }
+        else if (ret != Z_OK && ret != Z_BUF_ERROR)
+        {
+            std::cerr << "Error: corrupt gzip data in " << m_Path << std::endl;
+            result = false;
+            break;
+        }
+
+        if (stream.avail_out == 0)
+        {
+            // There may be more output waiting even
+            // once all of the input has been read
+            result = Emit(block, block.size());
+            stream.next_out = (Bytef*)block.data();
+            stream.avail_out = block.size();
+        }
+        else if (eof && stream.avail_in == 0)
+        {
+            // The file ending part way through a member means it was cut short
+            if (inMember)
+            {
+                std::cerr << "Error: unexpected end of gzip data in " << m_Path << std::endl;
+                result = false;
+            }
+            break;
+        }
+    }
+
+    if (result)
+    {
+        Emit(block, block.size() - stream.avail_out);
+    }
+
+    inflateEnd(&stream);
+    return result;
+}
+
+const bool
+DecompressBuffer::DecompressXz(
+    void
+)
+{
+#ifdef HAVE_LZMA
+    std::vector<uint8_t> input(DECOMPRESS_INPUT_SIZE);
+    std::vector<char> block(DECOMPRESS_BLOCK_SIZE);
+    lzma_stream stream = LZMA_STREAM_INIT;
+
+    if (lzma_stream_decoder(&stream, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK)
+    {
+        std::cerr << "Error: unable to initialize lzma" << std::endl;
+        return false;
+    }
+
+    stream.next_out = (uint8_t*)block.data();
+    stream.avail_out = block.size();
+
+    lzma_action action = LZMA_RUN;
+    bool result = true;
+    while (result)
+    {
+        if (stream.avail_in == 0 && action == LZMA_RUN)
+        {
+            stream.avail_in = fread(input.data(), 1, input.size(), m_File);
+            stream.next_in = input.data();
+            if (stream.avail_in == 0)
+            {
+                // Concatenated streams need telling where the input ends
+                action = LZMA_FINISH;
+            }
+        }
+
+        const lzma_ret ret = lzma_code(&stream, action);
+        if (ret != LZMA_OK && ret != LZMA_STREAM_END)
+        {
+            std::cerr << "Error: corrupt xz data in " << m_Path << std::endl;
+            result = false;
+            break;
+        }
+
+        if (stream.avail_out == 0 || ret == LZMA_STREAM_END)
+        {
+            result = Emit(block, block.size() - stream.avail_out);
+            stream.next_out = (uint8_t*)block.data();
+            stream.avail_out = block.size();
+        }
+
+        if (ret == LZMA_STREAM_END)
+        {
+            break;
+        }
+    }
+
+    lzma_end(&stream);
+    return result;
+#else
+    return false;
+#endif
+}
+
+const bool
+DecompressBuffer::DecompressZstd(
+    void
+)
+{
+#ifdef HAVE_ZSTD
+    // Frames are found and handed out straight from the mapped file
+    auto mapping = cracktools::MmapFileSpan<const uint8_t>(
+        m_Path,
+        PROT_READ,
+        MAP_PRIVATE
+    );
+
+    if (!mapping.has_value())
+    {
+        std::cerr << "Error: unable to map " << m_Path << std::endl;
+        return false;
+    }
+
+    FILE* handle = std::get<FILE*>(mapping.value());
+    std::span<const uint8_t> input = std::get<std::span<const uint8_t>>(mapping.value());
+    cracktools::MadviseSpan(input, MADV_SEQUENTIAL);
+
+    std::vector<char> block(DECOMPRESS_BLOCK_SIZE);
+    ZSTD_DStream* stream = ZSTD_createDStream();
+
+    if (stream == nullptr || ZSTD_isError(ZSTD_initDStream(stream)))
+    {
+        std::cerr << "Error: unable to initialize zstd" << std::endl;
+        ZSTD_freeDStream(stream);
+        cracktools::UnmapFileSpan(input, handle);
+        return false;
+    }
+
+    // Frames are independent, so files holding several of them, such as
+    // those written by pzstd or joined with cat, are decompressed a frame
+    // per thread. The frames are queued in file order and emitted in the
+    // same order once each is done
+    const size_t threads = std::min<size_t>(std::max(std::thread::hardware_concurrency(), 1u), DECOMPRESS_ZSTD_THREADS);
+    dispatch::DispatcherPoolPtr pool;
+    std::mutex lock;
+    std::condition_variable changed;
+    std::deque<std::shared_ptr<ZstdFrame>> frames;
+
+    // Emits the oldest frame, or just waits for it once the
+    // stream is closed or has failed and it is not wanted
+    bool result = true;
+    auto emitFrame = [&]() {
+        std::shared_ptr<ZstdFrame> frame = frames.front();
+        frames.pop_front();
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            changed.wait(guard, [&frame]{ return frame->done; });
+        }
+        if (!result)
+        {
+            return;
+        }
+        if (frame->failed)
+        {
+            std::cerr << "Error: corrupt zstd data in " << m_Path << std::endl;
+            result = false;
+            return;
+        }
+        result = Emit(frame->output, frame->output.size());
+    };
+
+    size_t offset = 0;
+    while (result && offset < input.size())
+    {
+        const std::span<const uint8_t> rest = input.subspan(offset);
+        const unsigned long long contentSize = ZSTD_getFrameContentSize(rest.data(), rest.size());
+
+        // Frames of a known and modest size go to the pool
+        if (contentSize != ZSTD_CONTENTSIZE_UNKNOWN &&
+            contentSize != ZSTD_CONTENTSIZE_ERROR &&
+            contentSize <= DECOMPRESS_ZSTD_FRAME_LIMIT)
+        {
+            const size_t frameSize = ZSTD_findFrameCompressedSize(rest.data(), rest.size());
+            if (ZSTD_isError(frameSize))
+            {
+                std::cerr << "Error: corrupt zstd data in " << m_Path << ": " << ZSTD_getErrorName(frameSize) << std::endl;
+                result = false;
+                break;
+            }
+
+            if (pool == nullptr)
+            {
+                pool = dispatch::CreateDispatchPool("zstd", threads);
+            }
+
+            while (frames.size() >= threads * 2 && result)
+            {
+                emitFrame();
+            }
+
+            auto frame = std::make_shared<ZstdFrame>();
+            frame->input = rest.first(frameSize);
+            frame->output.resize(contentSize);
+            frames.push_back(frame);
+            pool->PostTask(
+                [frame, &lock, &changed]() {
+                    const size_t ret = ZSTD_decompress(
+                        frame->output.data(), frame->output.size(),
+                        frame->input.data(), frame->input.size()
+                    );
+                    {
+                        std::lock_guard<std::mutex> guard(lock);
+                        frame->failed = ZSTD_isError(ret) || ret != frame->output.size();
+                        frame->done = true;
+                    }
+                    changed.notify_all();
+                }
+            );
+
+            offset += frameSize;
+            continue;
+        }
+
+        // Frames written without their size, or too large to hold
+        // whole, are streamed here once the pool has caught up
+        while (!frames.empty() && result)
+        {
+            emitFrame();
+        }
+
+        if (!result)
+        {
+            break;
+        }
+
+        ZSTD_DCtx_reset(stream, ZSTD_reset_session_only);
+        ZSTD_inBuffer in = { rest.data(), rest.size(), 0 };
+        ZSTD_outBuffer output = { block.data(), block.size(), 0 };
+        // Zero once the frame has been fully decoded and flushed,
+        // the stream stops there so in.pos is the frame size
+        size_t remaining = 0;
+        bool full = false;
+        do
+        {
+            remaining = ZSTD_decompressStream(stream, &output, &in);
+            if (ZSTD_isError(remaining))
+            {
+                std::cerr << "Error: corrupt zstd data in " << m_Path << ": " << ZSTD_getErrorName(remaining) << std::endl;
+                result = false;
+                break;
+            }
+
+            // A full block can leave more output waiting
+            // even once all of the input has been used
+            full = output.pos == output.size;
+            if (full)
+            {
+                result = Emit(block, block.size());
+                output = { block.data(), block.size(), 0 };
+            }
+        } while (result && remaining != 0 && (in.pos < in.size || full));
+
+        if (result && remaining != 0)
+        {
+            std::cerr << "Error: unexpected end of zstd data in " << m_Path << std::endl;
+            result = false;
+        }
+
+        if (result)
+        {
+            result = Emit(block, output.pos);
+        }
+
+        offset += in.pos;
+    }
+
+    // Every frame handed to the pool refers to the mapping
+    // so they all need to finish before it is unmapped
+    while (!frames.empty())
+    {
+        emitFrame();
+    }
+
+    if (pool != nullptr)
+    {
+        pool->Stop();
+        pool->Wait();
+    }
+
+    ZSTD_freeDStream(stream);
+    cracktools::UnmapFileSpan(input, handle);
+    return result;
+#else
+    return false;
+#endif
+}
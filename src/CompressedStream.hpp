@@ -0,0 +1,82 @@
+//
+//  CompressedStream.hpp
+//  CrackTools
+//
+//  Created by Kryc on 16/10/2026.
+//  Copyright © 2026 Kryc. All rights reserved.
+//
+
+#ifndef CompressedStream_hpp
+#define CompressedStream_hpp
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <istream>
+#include <mutex>
+#include <streambuf>
+#include <vector>
+
+#include "DispatchQueue.hpp"
+
+typedef enum
+{
+    CompressionNone,
+    CompressionGzip,
+    CompressionXz,
+    CompressionZstd
+} Compression;
+
+// The uncompressed bytes of a file handed out a block at a time. A
+// dispatcher decompresses a few blocks ahead of the reader so that
+// decompression runs alongside whatever is consuming the stream
+class DecompressBuffer : public std::streambuf
+{
+public:
+    DecompressBuffer(void) = default;
+    ~DecompressBuffer(void) { Close(); }
+    const bool Open(const std::filesystem::path& Path, const Compression Type);
+    void Close(void);
+    const bool IsOpen(void) const { return m_File != nullptr; }
+    // True once decompression has stopped on corrupt or truncated
+    // data, the reader sees this as the end of the stream
+    const bool Failed(void);
+protected:
+    int_type underflow(void) override;
+private:
+    void Decompress(void);
+    const bool DecompressGzip(void);
+    const bool DecompressXz(void);
+    const bool DecompressZstd(void);
+    // Queues a full block for the reader and starts a new one,
+    // false if the buffer is being closed and it should stop
+    const bool Emit(std::vector<char>& Block, const size_t Length);
+    FILE* m_File = nullptr;
+    std::filesystem::path m_Path;
+    Compression m_Compression = CompressionNone;
+    dispatch::DispatcherBasePtr m_Dispatcher;
+    std::mutex m_Lock;
+    std::condition_variable m_Changed;
+    std::deque<std::vector<char>> m_Blocks;
+    std::vector<char> m_Current;
+    bool m_Done = false;
+    bool m_Closing = false;
+    bool m_Failed = false;
+};
+
+// An istream over a gzip, xz or zstd compressed file
+class CompressedStream : public std::istream
+{
+public:
+    CompressedStream(void) : std::istream(nullptr) {}
+    // Identifies a compressed file from its magic bytes
+    static const Compression Detect(const std::filesystem::path& Path);
+    const bool Open(const std::filesystem::path& Path);
+    const bool IsOpen(void) const { return m_Buffer.IsOpen(); }
+    const bool Failed(void) { return m_Buffer.Failed(); }
+private:
+    DecompressBuffer m_Buffer;
+};
+
+#endif /* CompressedStream_hpp */
@@ -185,7 +185,10 @@ int main(
 
     if (/*action*/ positionals[0] == "build")
     {
-        db.Build(hashes, positionals[1]);
+        if (!db.Build(hashes, positionals[1]))
+        {
+            return 1;
+        }
     }
     else if (/*action*/ positionals[0] == "test")
     {
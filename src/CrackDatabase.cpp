@@ -16,6 +16,7 @@
 
 #include "SimdHash.hpp"
 
+#include "CompressedStream.hpp"
 #include "CrackDatabase.hpp"
 #include "UnsafeBuffer.hpp"
 #include "Util.hpp"
@@ -174,13 +175,24 @@ CrackDatabase::Build(
     }
 
     std::ifstream istr;
+    CompressedStream compressed;
 
     if (InputWords != "-")
     {
-        istr.open(InputWords, std::ios::in);
+        if (CompressedStream::Detect(InputWords) != CompressionNone)
+        {
+            if (!compressed.Open(InputWords))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            istr.open(InputWords, std::ios::in);
+        }
     }
 
-    std::istream& input = istr.is_open() ? istr : std::cin;
+    std::istream& input = compressed.IsOpen() ? compressed : istr.is_open() ? (std::istream&)istr : std::cin;
 
     uint8_t digest[MAX_DIGEST_LENGTH];
     DatabaseRecord record;
@@ -247,6 +259,13 @@ CrackDatabase::Build(
 
     istr.close();
 
+    // Don't build a database from part of a corrupt or truncated wordlist
+    if (compressed.IsOpen() && compressed.Failed())
+    {
+        std::cerr << "Error: unable to read all of " << InputWords << std::endl;
+        return false;
+    }
+
     for (auto& [algorithm, handle] : dbHandleMap)
     {
         handle.close();
@@ -9,6 +9,7 @@
 #include <assert.h>
 
 #include <algorithm>
+#include <deque>
 #include <format>
 #include <filesystem>
 #include <iostream>
@@ -23,83 +24,250 @@
 
 #include "CrackList.hpp"
 #include "HashList.hpp"
+#include "LineScanner.hpp"
+#include "RuleSet.hpp"
+#include "TransposedBuffer.hpp"
 #include "Util.hpp"
 
 #define MAX_STRING_LENGTH 128
+// Mapped wordlists are split into chunks of roughly a
+// block of words, assuming this many bytes per line
+#define WORDLIST_BYTES_PER_LINE 10
 
-const bool
-CrackList::CrackLinear(
-    void
-)
+void
+CrackList::CrackBlock(
+    std::span<const std::string_view> Block,
+    CrackedBatch& Cracked
+) const
 {
-    std::ostream& output = m_OutputFileStream.is_open() ? m_OutputFileStream : std::cout;
-    std::string last_cracked;
-
-    std::cerr << "Performing linear crack" << std::endl;
-
-    auto start = std::chrono::system_clock::now();
-
     const size_t lanes = SimdLanes();
     const size_t hashWidth = GetHashWidth(m_Algorithm);
     SimdHashBufferFixed<MAX_STRING_LENGTH> words;
     std::array<uint8_t, MAX_HASH_SIZE * MAX_LANES> hashes;
     std::span<uint8_t, MAX_HASH_SIZE * MAX_LANES> hashspan(hashes);
 
-    while (!m_Exhausted)
+    auto hashLanes = [&](SimdHashBufferFixed<MAX_STRING_LENGTH>& Words, const size_t Count) {
+        SimdHash(
+            m_Algorithm,
+            Words.GetLengths(),
+            Words.ConstBuffers(),
+            &hashes[0]
+        );
+
+        for (size_t h = 0; h < Count; h++)
+        {
+            auto hash = hashspan.subspan(h * hashWidth, hashWidth);
+            // In linkedin mode we need to mask
+            // the high order bytes
+            if (m_LinkedIn)
+            {
+                hash[0] = 0;
+                hash[1] = 0;
+                hash[2] &= 0x0f;
+            }
+            // Formatting is left to the output stage
+            if (m_HashList.Lookup(hash))
+            {
+                Cracked.hashes.insert(Cracked.hashes.end(), hash.begin(), hash.end());
+                Cracked.words.push_back(Words.GetString(h));
+            }
+        }
+    };
+
+    if (m_HybridMask.has_value())
     {
-        auto block = ReadBlock();
+        // The mask is stepped through by an odometer for each word,
+        // which sits in front of or behind the mask as a fixed part
+        size_t lane = 0;
+        for (const auto& word : Block)
+        {
+            MaskOdometer odometer(
+                *m_HybridMask,
+                m_HybridPrepend ? std::string_view() : std::string_view(word),
+                m_HybridPrepend ? std::string_view(word) : std::string_view()
+            );
+            odometer.Seek(m_HybridFirst);
 
-        // Can be empty if the input is blocksize aligned
-        if (block.empty())
+            for (size_t i = 0; i < m_HybridKeyspace; i++)
+            {
+                words.SetLength(lane, odometer.Next(words.GetBufferChar(lane)));
+
+                if (++lane == lanes)
+                {
+                    hashLanes(words, lane);
+                    lane = 0;
+                }
+            }
+        }
+
+        if (lane > 0)
         {
-            continue;
+            hashLanes(words, lane);
         }
+        return;
+    }
 
-        for (size_t i = 0; i < block.size(); i+=lanes)
+    if (m_CombinatorOffsets.size() > 1)
+    {
+        // Every left word is joined to every right word
+        // straight into the lanes, nothing is materialized
+        size_t lane = 0;
+        for (const auto& left : Block)
         {
-            const size_t remaining = std::min(lanes, block.size() - i);
+            const std::string prefix = std::string(left) + m_Join;
+            for (size_t right = 0; right + 1 < m_CombinatorOffsets.size(); right++)
+            {
+                auto buffer = words.GetBufferChar(lane);
+                const size_t prefixLength = std::min(prefix.size(), buffer.size());
+                const size_t rightLength = std::min<size_t>(
+                    m_CombinatorOffsets[right + 1] - m_CombinatorOffsets[right],
+                    buffer.size() - prefixLength
+                );
+                memcpy(buffer.data(), prefix.data(), prefixLength);
+                memcpy(buffer.data() + prefixLength, &m_CombinatorArena[m_CombinatorOffsets[right]], rightLength);
+                words.SetLength(lane, prefixLength + rightLength);
+
+                if (++lane == lanes)
+                {
+                    hashLanes(words, lane);
+                    lane = 0;
+                }
+            }
+        }
+
+        if (lane > 0)
+        {
+            hashLanes(words, lane);
+        }
+        return;
+    }
+
+    if (m_Rules.Empty())
+    {
+        for (size_t i = 0; i < Block.size(); i += lanes)
+        {
+            const size_t remaining = std::min(lanes, Block.size() - i);
             for (size_t h = 0; h < remaining; h++)
             {
-                words.Set(h, block[i + h]);
+                auto buffer = words.GetBufferChar(h);
+                const size_t length = std::min(Block[i + h].size(), buffer.size());
+                memcpy(buffer.data(), Block[i + h].data(), length);
+                words.SetLength(h, length);
             }
+            hashLanes(words, remaining);
+        }
+        return;
+    }
 
-            SimdHash(
-                m_Algorithm,
-                words.GetLengths(),
-                words.ConstBuffers(),
-                &hashes[0]
-            );
+    // Rules are applied a group of words at a time, rule by rule. Simple
+    // rules change every lane at once in a transposed copy of the words,
+    // the rest are applied to each word in turn and packed into lanes
+    // separately, as rejected candidates do not take up a lane
+    TransposedBuffer<MAX_STRING_LENGTH> base;
+    TransposedBuffer<MAX_STRING_LENGTH> candidates;
+    SimdHashBufferFixed<MAX_STRING_LENGTH> packed;
+    size_t lane = 0;
+    for (size_t i = 0; i < Block.size(); i += lanes)
+    {
+        const size_t remaining = std::min(lanes, Block.size() - i);
+        base.Clear();
+        for (size_t h = 0; h < remaining; h++)
+        {
+            base.Set(h, Block[i + h]);
+        }
+
+        for (size_t rule = 0; rule < m_Rules.GetCount(); rule++)
+        {
+            if (m_Rules.IsLaneRule(rule))
+            {
+                candidates.CopyFrom(base);
+                m_Rules.ApplyLanes(rule, candidates);
+                candidates.Store(words, remaining);
+                hashLanes(words, remaining);
+                continue;
+            }
 
             for (size_t h = 0; h < remaining; h++)
             {
-                auto hash = hashspan.subspan(h * hashWidth, hashWidth);
-                // In linkedin mode we need to mask
-                // the high order bytes
-                if (m_LinkedIn)
+                const size_t length = m_Rules.Apply(rule, Block[i + h], packed.GetBufferChar(lane));
+                if (length == RuleSet::kRejected)
                 {
-                    hash[0] = 0;
-                    hash[1] = 0;
-                    hash[2] &= 0x0f;
+                    continue;
                 }
-                if (m_HashList.Lookup(hash))
+                packed.SetLength(lane, length);
+
+                if (++lane == lanes)
                 {
-                    auto hex = Util::ToHex(hash);
-                    hex = Util::ToLower(hex);
-                    m_Cracked++;
-                    output << hex << m_Separator << Util::Hexlify(words.GetString(h)) << std::endl;
-                    last_cracked = block[h];
+                    hashLanes(packed, lane);
+                    lane = 0;
                 }
             }
         }
+    }
+
+    if (lane > 0)
+    {
+        hashLanes(packed, lane);
+    }
+}
+
+const bool
+CrackList::CrackLinear(
+    void
+)
+{
+    std::vector<std::string> block;
+    std::vector<std::string_view> words;
+    std::vector<uint32_t> newlines;
+    std::deque<std::string> decoded;
+    std::string last_cracked;
+
+    std::cerr << "Performing linear crack" << std::endl;
+
+    auto start = std::chrono::system_clock::now();
+
+    while (true)
+    {
+        if (m_WordlistMapped)
+        {
+            if (!ReadChunk(words, newlines, decoded))
+            {
+                break;
+            }
+        }
+        else
+        {
+            if (m_Exhausted)
+            {
+                break;
+            }
+            ReadBlock(block);
+            words.assign(block.begin(), block.end());
+        }
+
+        // Can be empty if the input is blocksize aligned
+        if (words.empty())
+        {
+            continue;
+        }
+
+        CrackedBatch cracked;
+        CrackBlock(words, cracked);
+
+        if (!cracked.words.empty())
+        {
+            last_cracked = cracked.words.back();
+            OutputResults(cracked);
+        }
 
         m_BlocksProcessed++;
 
         auto end = std::chrono::system_clock::now();
         auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-        ThreadPulse(0, elapsed_ms.count(), last_cracked, block.back());
+        ThreadPulse(0, elapsed_ms.count(), last_cracked, std::string(words.back()));
         start = std::chrono::system_clock::now();
 
-        if (m_Cracked == m_Count)
+        if (m_Finished)
         {
             break;
         }
@@ -108,39 +276,69 @@ CrackList::CrackLinear(
 }
 
 void
-CrackList::OutputResultsInternal(
-    std::vector<std::tuple<std::vector<uint8_t>,std::string,std::string>>& Results
+CrackList::OutputResults(
+    CrackedBatch& Results
 )
 {
     std::ostream& output = m_OutputFileStream.is_open() ? m_OutputFileStream : std::cout;
+    const size_t hashWidth = GetHashWidth(m_Algorithm);
+    std::span<const uint8_t> hashes(Results.hashes);
 
-    for (auto& [h,x,v] : Results)
+    // The whole batch is formatted then written and flushed
+    // once, rather than flushing after every line
+    m_OutputBuffer.clear();
+    for (size_t i = 0; i < Results.words.size(); i++)
     {
+        auto hash = hashes.subspan(i * hashWidth, hashWidth);
+
+        // Duplicate words and candidates crack the same hash again, only
+        // the first is kept. Only this stage touches the flags so they
+        // need no locking. Repeated targets share the flag of the first
+        auto index = m_HashList.Find(hash);
+        if (!index.has_value())
+        {
+            continue;
+        }
+        size_t first = index.value();
+        while (first > 0 && std::ranges::equal(m_HashList.GetHash(first - 1), hash))
+        {
+            first--;
+        }
+        if (m_CrackedHashes[first])
+        {
+            continue;
+        }
+        m_CrackedHashes[first] = true;
         m_Cracked++;
-        output << x << m_Separator << v << std::endl;
-        m_LastCracked = v;
+
+        Util::ToHex(hash, m_OutputBuffer);
+        m_OutputBuffer += m_Separator;
+        m_OutputBuffer += Util::Hexlify(Results.words[i]);
+        m_OutputBuffer += '\n';
     }
 
-    // Check if we have found all the tarets
-    if (m_Cracked == m_Count)
+    if (!m_OutputBuffer.empty())
+    {
+        output.write(m_OutputBuffer.data(), m_OutputBuffer.size());
+        output.flush();
+    }
+
+    // Check if we have found all the targets
+    if (m_Cracked == m_Count && !m_Finished)
     {
         m_Finished = true;
+        // Stop the reader straight away, the workers
+        // stop as they come to their next block
+        m_InputQueue.Close();
     }
 }
 
 void
-CrackList::OutputResults(
+CrackList::StopOutput(
     void
 )
 {
-    // Take a copy of the results
-    std::vector<std::tuple<std::vector<uint8_t>,std::string,std::string>> copy;
-    {
-        std::lock_guard<std::mutex> lock(m_ResultsMutex);
-        copy = std::move(m_Results);
-    }
-
-    OutputResultsInternal(copy);
+    dispatch::CurrentQueue()->Stop();
 }
 
 void
@@ -179,18 +377,18 @@ CrackList::ThreadPulse(
 
         // The number of hashes per second
         std::string hps_ch;
-        double hashesPerSec = (double)(m_BlockSize * 1000 * m_Threads) / averageMs;
+        double hashesPerSec = (double)(m_WordsPerBlock * CandidatesPerWord() * 1000 * m_Threads) / averageMs;
         hashesPerSec = Util::NumFactor(hashesPerSec, hps_ch);
         // double hashesPerSec = (double)(m_BlockSize * 1000) / BlockTime;
 
-        const size_t hashcount = m_HashList.GetCount();
+        const size_t hashcount = m_Count;
         double percent = ((double)m_Cracked / hashcount) * 100.f;
 
         std::string status = std::format(
             "H/s:{:.1f}{} C:{}/{} ({:.1f}%) T:{} C:\"{}\" L:\"{}\"",
             hashesPerSec,
             hps_ch,
-            m_Cracked,
+            m_Cracked.load(),
             hashcount,
             percent,
             m_WordsProcessed.load(),
@@ -225,6 +423,16 @@ CrackList::WorkerFinished(
         // Stop the pool
         m_DispatchPool->Stop();
         m_DispatchPool->Wait();
+        // Every batch was posted ahead of this so the
+        // output is complete once the stage stops
+        dispatch::PostTaskToDispatcher(
+            "output",
+            std::bind(
+                &CrackList::StopOutput,
+                this
+            )
+        );
+        m_OutputThread->Wait();
         // Stop the current main thread
         dispatch::CurrentDispatcher()->Stop();
     }
@@ -236,39 +444,51 @@ CrackList::CrackWorker(
 )
 {
     std::vector<std::string> block;
+    std::vector<std::string_view> words;
+    std::vector<uint32_t> newlines;
+    std::deque<std::string> decoded;
     std::string last_cracked;
-
-    srand(Id);
+    bool finished = false;
 
     // Check if all input is done
+    if (m_Finished)
     {
-        std::lock_guard<std::mutex> lock(m_InputMutex);
-        if (m_Finished && m_InputCache.empty())
-        {
-            // Track the completion of this worker
-            dispatch::PostTaskToDispatcher(
-                "main",
-                std::bind(
-                    &CrackList::WorkerFinished,
-                    this
-                )
-            );
-            // Terminate our current queue
-            dispatch::CurrentQueue()->Stop();
-            return;
-        }
+        // Everything is cracked, so wake the
+        // reader if it is waiting for space
+        m_InputQueue.Close();
+        finished = true;
+    }
+    else if (m_WordlistMapped)
+    {
+        // Workers claim their own chunks of a mapped
+        // wordlist so there is no input to wait for
+        finished = !ReadChunk(words, newlines, decoded);
+    }
+    else
+    {
+        // Sleeps until the reader has a block or has run out
+        finished = !m_InputQueue.Pop(block);
+        words.assign(block.begin(), block.end());
+    }
 
-        if (!m_InputCache.empty())
-        {
-            block = std::move(m_InputCache.front());
-            m_InputCache.pop();
-        }
+    if (finished)
+    {
+        // Track the completion of this worker
+        dispatch::PostTaskToDispatcher(
+            "main",
+            std::bind(
+                &CrackList::WorkerFinished,
+                this
+            )
+        );
+        // Terminate our current queue
+        dispatch::CurrentQueue()->Stop();
+        return;
     }
 
-    // We need to wait for more input
-    if (block.empty())
+    // A mapped chunk can hold only the middle of a line
+    if (words.empty())
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(rand() % 100));
         dispatch::PostTaskFast(
             dispatch::bind(
                 &CrackList::CrackWorker,
@@ -279,75 +499,28 @@ CrackList::CrackWorker(
         return;
     }
 
-    std::vector<std::tuple<std::vector<uint8_t>,std::string,std::string>> cracked;
+    CrackedBatch cracked;
 
     auto start = std::chrono::system_clock::now();
 
-    const size_t lanes = SimdLanes();
-    const size_t hashWidth = GetHashWidth(m_Algorithm);
-    SimdHashBufferFixed<MAX_STRING_LENGTH> words;
-    std::array<uint8_t, MAX_HASH_SIZE * MAX_LANES> hashes;
-    std::span<uint8_t, MAX_HASH_SIZE * MAX_LANES> hashspan(hashes);
-
-    for (size_t i = 0; i < block.size(); i+=lanes)
-    {
-        const size_t remaining = std::min(lanes, block.size() - i);
-        for (size_t h = 0; h < remaining; h++)
-        {
-            words.Set(h, block[i + h]);
-        }
-
-        SimdHash(
-            m_Algorithm,
-            words.GetLengths(),
-            words.ConstBuffers(),
-            &hashes[0]
-        );
-
-        for (size_t h = 0; h < remaining; h++)
-        {
-            auto hash = hashspan.subspan(h * hashWidth, hashWidth);
-            // In linkedin mode we need to mask
-            // the high order bytes
-            if (m_LinkedIn)
-            {
-                hash[0] = 0;
-                hash[1] = 0;
-                hash[2] &= 0x0f;
-            }
-            if (m_HashList.Lookup(hash))
-            {
-                auto hex = Util::ToHex(hash);
-                hex = Util::ToLower(hex);
-                cracked.push_back({
-                    {hash.begin(), hash.end()},
-                    hex,
-                    Util::Hexlify(words.GetString(h))
-                });
-            }
-        }
-    }
+    CrackBlock(words, cracked);
 
     auto end = std::chrono::system_clock::now();
     auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
 
-    if (cracked.size() > 0)
-    {
-        std::lock_guard<std::mutex> lock(m_ResultsMutex);
-        last_cracked = std::get<2>(cracked.back());
-        OutputResultsInternal(cracked);
-        // bool willupdate = m_Results.size() < 8192;
-        // m_Results.insert(m_Results.end(), cracked.begin(), cracked.end());
-        // if (m_Results.size() > 8192 && willupdate)
-        // {
-        //     dispatch::PostTaskToDispatcher(
-        //         "io",
-        //         std::bind(
-        //             &CrackList::OutputResults,
-        //             this
-        //         )
-        //     );
-        // }
+    // Results are handed to the output stage so
+    // workers never wait on each other to write
+    if (!cracked.words.empty())
+    {
+        last_cracked = cracked.words.back();
+        dispatch::PostTaskToDispatcher(
+            "output",
+            std::bind(
+                &CrackList::OutputResults,
+                this,
+                std::move(cracked)
+            )
+        );
     }
 
     m_BlocksProcessed++;
@@ -360,10 +533,17 @@ CrackList::CrackWorker(
             Id,
             elapsed_ms.count(),
             last_cracked,
-            block.back()
+            std::string(words.back())
         )
     );
 
+    // Hand the block back to the reader to fill again,
+    // its strings keep their memory from this round
+    if (!block.empty())
+    {
+        m_FreeBlocks.TryPush(std::move(block));
+    }
+
     dispatch::PostTaskFast(
         std::bind(
             &CrackList::CrackWorker,
@@ -373,102 +553,271 @@ CrackList::CrackWorker(
     );
 }
 
-std::vector<std::string>
-CrackList::ReadBlock(
+const bool
+CrackList::ParseLine(
+    std::string& Line
+) const
+{
+    // Strip carriage return if present at the end
+    if (!Line.empty() && Line.back() == '\r')
+    {
+        Line.pop_back();
+    }
+
+    if (Line.empty())
+    {
+        return false;
+    }
+
+    // Handle parsing "$HEX[]" input.
+    if (m_ParseHexInput && Line.starts_with("$HEX[") && Line.back() == ']')
+    {
+        auto bytes = Util::ParseHex(Line.substr(5, Line.size() - 6));
+        Line = std::string(bytes.begin(), bytes.end());
+    }
+
+    return true;
+}
+
+const bool
+CrackList::LoadCombinator(
     void
 )
 {
-    std::istream& input = m_WordlistFileStream.is_open() ? m_WordlistFileStream : std::cin;
-    std::vector<std::string> block;
-    std::string line;
-
-    block.reserve(m_BlockSize);
+    std::ifstream infile(m_Combinator);
+    if (!infile.is_open())
+    {
+        std::cerr << "Error: unable to open combinator wordlist " << m_Combinator << std::endl;
+        return false;
+    }
 
-    // Loop until the block is full or the input is exhausted
-    while(block.size() < m_BlockSize)
+    // The right words are packed end to end with
+    // the offset of each kept alongside
+    std::string line;
+    std::string last;
+    m_CombinatorOffsets = { 0 };
+    while (std::getline(infile, line))
     {
-        if (input.eof())
+        if (!ParseLine(line) || line == last)
         {
-            m_Exhausted = true;
-            break;
+            continue;
         }
 
-        std::getline(input, line);
+        m_CombinatorArena.insert(m_CombinatorArena.end(), line.begin(), line.end());
+        m_CombinatorOffsets.push_back(m_CombinatorArena.size());
+        last = std::move(line);
+    }
+
+    if (m_CombinatorOffsets.size() == 1)
+    {
+        std::cerr << "Error: combinator wordlist " << m_Combinator << " is empty" << std::endl;
+        return false;
+    }
+
+    std::cerr << "Loaded " << m_CombinatorOffsets.size() - 1 << " combinator words" << std::endl;
+    return true;
+}
+
+const size_t
+CrackList::CandidatesPerWord(
+    void
+) const
+{
+    if (m_HybridMask.has_value())
+    {
+        return m_HybridKeyspace;
+    }
+    if (m_CombinatorOffsets.size() > 1)
+    {
+        return m_CombinatorOffsets.size() - 1;
+    }
+    return std::max<size_t>(m_Rules.GetCount(), 1);
+}
+
+const bool
+CrackList::MapWordlist(
+    void
+)
+{
+    m_WordlistMapped = true;
+
+    // An empty file can not be mapped, it simply has no chunks
+    if (std::filesystem::file_size(m_Wordlist) == 0)
+    {
+        return true;
+    }
+
+    auto mapping = cracktools::MmapFileSpan<const char>(
+        m_Wordlist,
+        PROT_READ,
+        MAP_PRIVATE
+    );
+
+    if (!mapping.has_value())
+    {
+        std::cerr << "Error: unable to map wordlist " << m_Wordlist << std::endl;
+        return false;
+    }
+
+    m_WordlistHandle = std::get<FILE*>(mapping.value());
+    m_MappedWordlist = std::get<std::span<const char>>(mapping.value());
+
+    // Chunks are claimed in order so the file is read front to back
+    cracktools::MadviseSpan(m_MappedWordlist, MADV_SEQUENTIAL);
+
+    return true;
+}
+
+const bool
+CrackList::ReadChunk(
+    std::vector<std::string_view>& Block,
+    std::vector<uint32_t>& Newlines,
+    std::deque<std::string>& Decoded
+)
+{
+    const std::string_view data(m_MappedWordlist.data(), m_MappedWordlist.size());
+    const size_t start = m_NextChunk.fetch_add(m_ChunkSize);
+
+    Block.clear();
+    Newlines.clear();
+    Decoded.clear();
+
+    if (start >= data.size())
+    {
+        return false;
+    }
+
+    const size_t end = std::min(start + m_ChunkSize, data.size());
+
+    // A line belongs to the chunk holding its first byte, so
+    // skip the rest of a line begun in the previous chunk
+    size_t position = start;
+    if (start > 0)
+    {
+        const size_t newline = data.find('\n', start - 1);
+        position = newline == std::string_view::npos ? data.size() : newline + 1;
+    }
+
+    std::string_view last;
+    auto addLine = [&](const size_t Newline) {
+        std::string_view line = data.substr(position, Newline - position);
+        position = Newline + 1;
 
-        // Strip carriage return if present at the end
         if (!line.empty() && line.back() == '\r')
         {
-            line.pop_back();
+            line.remove_suffix(1);
         }
 
-        if (line.empty() || line == m_LastLine)
+        if (line.empty() || line == last)
         {
-            continue;
+            return;
         }
 
-        // Handle parsing "$HEX[]" input.
+        last = line;
+
+        // Decoded words need storage of their own,
+        // which a deque will not move as it grows
         if (m_ParseHexInput && line.starts_with("$HEX[") && line.back() == ']')
         {
             auto bytes = Util::ParseHex(line.substr(5, line.size() - 6));
-            line = std::string(bytes.begin(), bytes.end());
+            line = Decoded.emplace_back(bytes.begin(), bytes.end());
         }
 
-        m_LastLine = line;
-        block.push_back(std::move(line));
-        m_WordsProcessed++;
+        Block.push_back(line);
+    };
+
+    // Every newline in the chunk is found in one pass, leaving
+    // only a compare at each end of a line to strip and decode
+    if (position < end)
+    {
+        const size_t base = position;
+        LineScanner::FindNewlines(data.substr(base, end - base), Newlines);
+        for (const uint32_t newline : Newlines)
+        {
+            addLine(base + newline);
+        }
+    }
+
+    // The last line begun in the chunk runs on into the next
+    if (position < end)
+    {
+        const size_t newline = data.find('\n', end);
+        addLine(newline == std::string_view::npos ? data.size() : newline);
     }
 
-    return block;
+    m_WordsProcessed += Block.size();
+    return true;
 }
 
 void
-CrackList::ReadInput(
-    void
+CrackList::ReadBlock(
+    std::vector<std::string>& Block
 )
 {
-    // Terminate our current queue
-    if (m_Exhausted)
+    std::istream* input = &std::cin;
+    if (m_CompressedWordlist.IsOpen())
     {
-        // Signal to stop reading input
-        m_Finished = true;
-        // Kill the IO thread
-        dispatch::CurrentQueue()->Stop();
-        return;
+        input = &m_CompressedWordlist;
+    }
+    else if (m_WordlistFileStream.is_open())
+    {
+        input = &m_WordlistFileStream;
     }
 
-    bool cache_full = false;
+    // Lines are read into the strings already in the
+    // block, reusing their memory when it is recycled
+    size_t count = 0;
+    Block.resize(m_WordsPerBlock);
 
-    while(!m_Exhausted && !cache_full)
+    // Loop until the block is full or the input is exhausted
+    while(count < m_WordsPerBlock)
     {
-        auto block = ReadBlock();
-
-        if (!block.empty())
+        if (input->eof())
         {
-            std::lock_guard<std::mutex> lock(m_InputMutex);
+            m_Exhausted = true;
+            break;
+        }
 
-            m_InputCache.push(
-                std::move(block)
-            );
-            
-            if (m_InputCache.size() >= m_CacheSizeBlocks)
-            {
-                cache_full = true;
-            }
+        std::string& line = Block[count];
+        std::getline(*input, line);
+
+        if (!ParseLine(line) || line == m_LastLine)
+        {
+            continue;
         }
+
+        m_LastLine = line;
+        count++;
+        m_WordsProcessed++;
     }
 
-    if (cache_full)
+    Block.resize(count);
+}
+
+void
+CrackList::ReadInput(
+    void
+)
+{
+    // Read until the input runs out or the workers close
+    // the queue once every hash has been cracked
+    while (!m_Exhausted)
     {
-        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        std::vector<std::string> block;
+        m_FreeBlocks.TryPop(block);
+        ReadBlock(block);
+
+        if (!block.empty() && !m_InputQueue.Push(std::move(block)))
+        {
+            break;
+        }
     }
 
-    // Post the next task
-    dispatch::PostTaskFast(
-        dispatch::bind(
-            &CrackList::ReadInput,
-            this
-        )
-    );
+    // The workers take what is left and then stop
+    m_InputQueue.Close();
+
+    // Kill the IO thread
+    dispatch::CurrentQueue()->Stop();
 }
 
 const bool
@@ -491,7 +840,9 @@ CrackList::Crack(
         return false;
     }
 
-    // Open the input file
+    // Open the input file. Regular files are mapped and split between
+    // the workers, anything else is read a block at a time. Compressed
+    // files are decompressed on their own thread as the IO thread reads
     if (m_Wordlist != "-" && m_Wordlist != "")
     {
         if (!std::filesystem::exists(m_Wordlist))
@@ -499,7 +850,25 @@ CrackList::Crack(
             std::cerr << "Error: Wordlist file does not exist" << std::endl;
             return false;
         }
-        m_WordlistFileStream.open(m_Wordlist, std::ios::in);
+
+        if (CompressedStream::Detect(m_Wordlist) != CompressionNone)
+        {
+            if (!m_CompressedWordlist.Open(m_Wordlist))
+            {
+                return false;
+            }
+        }
+        else if (std::filesystem::is_regular_file(m_Wordlist))
+        {
+            if (!MapWordlist())
+            {
+                return false;
+            }
+        }
+        else
+        {
+            m_WordlistFileStream.open(m_Wordlist, std::ios::in);
+        }
     }
 
     if (m_OutFile != "")
@@ -599,7 +968,72 @@ CrackList::Crack(
         m_HashList.Initialize(m_Hashes, m_DigestLength, false);
     }
 
-    m_Count = m_HashList.GetCount();
+    // Repeated targets are only counted once, as they
+    // sit next to each other in the sorted list
+    m_Count = 0;
+    for (size_t i = 0; i < m_HashList.GetCount(); i++)
+    {
+        if (i == 0 || !std::ranges::equal(m_HashList.GetHash(i - 1), m_HashList.GetHash(i)))
+        {
+            m_Count++;
+        }
+    }
+    m_CrackedHashes.assign(m_HashList.GetCount(), false);
+
+    if (!m_RulesFile.empty())
+    {
+        if (!m_Rules.Load(m_RulesFile))
+        {
+            return false;
+        }
+
+        if (m_Rules.Empty())
+        {
+            std::cerr << "Error: no valid rules in " << m_RulesFile << std::endl;
+            return false;
+        }
+
+        std::cerr << "Loaded " << m_Rules.GetCount() << " rules" << std::endl;
+    }
+
+    if (!m_RulesFile.empty() + !m_Combinator.empty() + !m_HybridPattern.empty() > 1)
+    {
+        std::cerr << "Error: only one of rules, combinator or hybrid mask can be used" << std::endl;
+        return false;
+    }
+
+    if (!m_Combinator.empty() && !LoadCombinator())
+    {
+        return false;
+    }
+
+    if (!m_HybridPattern.empty())
+    {
+        m_HybridMask = Mask::Parse(m_HybridPattern, m_CustomCharsets);
+        if (!m_HybridMask.has_value())
+        {
+            std::cerr << "Error: invalid hybrid mask " << m_HybridPattern << std::endl;
+            return false;
+        }
+
+        // Each word expands to the whole mask so it has to be countable
+        const mpz_class keyspace = m_HybridMask->Keyspace(m_HybridMask->GetLength());
+        if (!keyspace.fits_ulong_p())
+        {
+            std::cerr << "Error: hybrid mask " << m_HybridPattern << " is too large" << std::endl;
+            return false;
+        }
+        m_HybridKeyspace = keyspace.get_ui();
+        m_HybridFirst = mpz_class(m_HybridMask->LengthIndex(m_HybridMask->GetLength())).get_ui();
+
+        std::cerr << "Using hybrid mask " << m_HybridPattern << " (" << m_HybridKeyspace << " per word)" << std::endl;
+    }
+
+    // Each word read expands into a candidate per rule, right word or
+    // mask word, so fewer are read at a time to keep blocks around the
+    // same amount of work and spread small lists over every thread
+    m_WordsPerBlock = std::max(m_BlockSize / CandidatesPerWord(), SimdLanes());
+    m_ChunkSize = std::min<size_t>(m_WordsPerBlock * WORDLIST_BYTES_PER_LINE, UINT32_MAX);
 
     std::cerr << "Beginning cracking" << std::endl;
     
@@ -614,34 +1048,43 @@ CrackList::Crack(
             m_Threads = std::thread::hardware_concurrency();
         }
 
-        // Create our IO thread
-        m_IoThread = dispatch::CreateDispatcher(
-            "io",
-            dispatch::bind(
-                &CrackList::ReadInput,
-                this
-            )
-        );
-
-        m_DispatchPool = dispatch::CreateDispatchPool("worker", m_Threads);
-        m_ActiveWorkers = m_Threads;
-
-        for (size_t i = 0; i < m_Threads; i++)
+        // Create our IO thread, mapped wordlists are read by the workers
+        if (!m_WordlistMapped)
         {
-            m_DispatchPool->PostTask(
+            m_IoThread = dispatch::CreateDispatcher(
+                "io",
                 dispatch::bind(
-                    &CrackList::CrackWorker,
-                    this,
-                    i
+                    &CrackList::ReadInput,
+                    this
                 )
             );
         }
 
+        // Cracked hashes are written out by their own stage
+        m_OutputThread = dispatch::CreateDispatcher(
+            "output",
+            dispatch::DoNothing
+        );
+
+        m_DispatchPool = dispatch::CreateDispatchPool("worker", m_Threads);
+        m_ActiveWorkers = m_Threads;
+
+        // The workers are started by the main dispatcher so it is there
+        // for any which run out of mapped input straight away
         dispatch::CreateAndEnterDispatcher(
             "main",
-            std::bind(
-                dispatch::DoNothing
-            )
+            [this]() {
+                for (size_t i = 0; i < m_Threads; i++)
+                {
+                    m_DispatchPool->PostTask(
+                        dispatch::bind(
+                            &CrackList::CrackWorker,
+                            this,
+                            i
+                        )
+                    );
+                }
+            }
         );
 
         result = true;
@@ -657,5 +1100,12 @@ CrackList::Crack(
     std::cerr << "Processed " << m_BlocksProcessed << " blocks" << std::endl;
     std::cerr << "Cracked   " << m_Cracked << " hashes" << std::endl;
 
+    // A corrupt or truncated wordlist ends early, so not every word was tried
+    if (m_CompressedWordlist.IsOpen() && m_CompressedWordlist.Failed())
+    {
+        std::cerr << "Error: unable to read all of " << m_Wordlist << std::endl;
+        result = false;
+    }
+
     return result;
 }
@@ -10,20 +10,28 @@
 #define CrackList_hpp
 
 #include <atomic>
+#include <deque>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <map>
 #include <mutex>
-#include <queue>
+#include <optional>
 #include <shared_mutex>
+#include <span>
 #include <string>
+#include <string_view>
 #include <tuple>
 
 #include "DispatchQueue.hpp"
 #include "simdhash.h"
 
+#include "BlockQueue.hpp"
+#include "CompressedStream.hpp"
 #include "HashList.hpp"
+#include "RuleSet.hpp"
+#include "UnsafeBuffer.hpp"
+#include "WordGenerator.hpp"
 
 typedef enum
 {
@@ -33,10 +41,19 @@ typedef enum
     InputTypeSingle
 } HashFileType;
 
+// The hashes cracked in a block, with the
+// digests packed end to end in word order
+typedef struct _CrackedBatch
+{
+    std::vector<uint8_t> hashes;
+    std::vector<std::string> words;
+} CrackedBatch;
+
 class CrackList
 {
 public:
     CrackList() = default;
+    ~CrackList(void) { cracktools::UnmapFileSpan(m_MappedWordlist, m_WordlistHandle); }
     void SetHashFile(const std::string HashFile) { m_HashFile = HashFile; }
     void SetOutFile(const std::filesystem::path OutFile) { m_OutFile = OutFile; }
     void SetWordlist(const std::string Wordlist) { m_Wordlist = Wordlist; }
@@ -51,6 +68,11 @@ public:
     void SetAutohex(const bool Autohex) { m_Hexlify = Autohex; }
     void SetBitmaskSize(const size_t BitmaskSize) { m_BitmaskSize = BitmaskSize; }
     void SetLinkedIn(const bool LinkedIn) { m_LinkedIn = LinkedIn; }
+    void SetRules(const std::filesystem::path Rules) { m_RulesFile = Rules; }
+    void SetCombinator(const std::filesystem::path Combinator) { m_Combinator = Combinator; }
+    void SetJoin(const std::string Join) { m_Join = Join; }
+    void SetHybridMask(const std::string Mask, const bool Prepend) { m_HybridPattern = Mask; m_HybridPrepend = Prepend; }
+    void SetCustomCharset(const size_t Index, const std::string Charset) { m_CustomCharsets.at(Index) = Charset; }
     const std::string GetHashFile(void) const { return m_HashFile; }
     const std::filesystem::path GetOutFile(void) const { return m_OutFile; }
     const std::string GetWordlist(void) const { return m_Wordlist; }
@@ -64,16 +86,26 @@ public:
     const bool GetAutohex(void) const { return m_Hexlify; }
     const bool GetParseHexInput(void) const { return m_ParseHexInput; }
     const bool GetLinkedIn(void) const { return m_LinkedIn; }
+    const std::filesystem::path GetRules(void) const { return m_RulesFile; }
+    const std::filesystem::path GetCombinator(void) const { return m_Combinator; }
+    const std::string GetJoin(void) const { return m_Join; }
+    const std::string GetHybridMask(void) const { return m_HybridPattern; }
     const bool Crack(void);
     const bool CrackLinear(void);
 private:
     void CrackWorker(const size_t Id);
+    void CrackBlock(std::span<const std::string_view> Block, CrackedBatch& Cracked) const;
     void ThreadPulse(const size_t ThreadId, const uint64_t BlockTime, const std::string LastCracked, const std::string LastTry);
     void WorkerFinished(void);
     void ReadInput(void);
-    std::vector<std::string> ReadBlock(void);
-    void OutputResults(void);
-    void OutputResultsInternal(std::vector<std::tuple<std::vector<uint8_t>,std::string,std::string>>& Results);
+    void ReadBlock(std::vector<std::string>& Block);
+    const bool MapWordlist(void);
+    const bool ReadChunk(std::vector<std::string_view>& Block, std::vector<uint32_t>& Newlines, std::deque<std::string>& Decoded);
+    const bool ParseLine(std::string& Line) const;
+    const bool LoadCombinator(void);
+    const size_t CandidatesPerWord(void) const;
+    void OutputResults(CrackedBatch& Results);
+    void StopOutput(void);
     bool m_Hexlify = true;
     size_t m_BitmaskSize = 16;
     std::vector<uint8_t> m_Hashes;
@@ -85,31 +117,52 @@ private:
     size_t m_DigestLength;
     HashList m_HashList;
     std::ifstream m_WordlistFileStream;
+    CompressedStream m_CompressedWordlist;
+    bool m_WordlistMapped = false;
+    std::span<const char> m_MappedWordlist;
+    FILE* m_WordlistHandle = nullptr;
+    std::atomic<size_t> m_NextChunk = 0;
+    size_t m_ChunkSize = 0;
     std::ofstream m_OutputFileStream;
     std::string m_Separator = ":";
     std::string m_LastLine;
     std::string m_LastCracked;
     size_t m_Count;
+    // Set for each target once it has been output
+    std::vector<bool> m_CrackedHashes;
     std::atomic<size_t> m_WordsProcessed = 0;
     std::atomic<size_t> m_BlocksProcessed = 0;
-    size_t m_Cracked = 0;
+    std::atomic<size_t> m_Cracked = 0;
     bool m_ParseHexInput = false;
     size_t m_TerminalWidth = 80;
     bool m_LinkedIn = false;
+    std::filesystem::path m_RulesFile;
+    RuleSet m_Rules;
+    std::filesystem::path m_Combinator;
+    std::string m_Join;
+    std::vector<char> m_CombinatorArena;
+    std::vector<size_t> m_CombinatorOffsets;
+    std::string m_HybridPattern;
+    bool m_HybridPrepend = false;
+    std::vector<std::string> m_CustomCharsets = std::vector<std::string>(4);
+    std::optional<Mask> m_HybridMask;
+    size_t m_HybridKeyspace = 0;
+    uint64_t m_HybridFirst = 0;
     // Threading
-    std::mutex m_InputMutex;
-    std::mutex m_ResultsMutex;
-    std::vector<std::tuple<std::vector<uint8_t>,std::string,std::string>> m_Results;
-    std::queue<std::vector<std::string>> m_InputCache;
-    size_t m_CacheSizeBlocks = 4096;
+    BlockQueue<std::vector<std::string>> m_InputQueue{4096};
+    // Blocks handed back by the workers for the reader to fill again
+    BlockQueue<std::vector<std::string>> m_FreeBlocks{64};
     bool m_Exhausted = false;
-    bool m_Finished = false;
+    std::atomic<bool> m_Finished = false;
     size_t m_Threads = 1;
     dispatch::DispatcherBasePtr m_MainThread;
     dispatch::DispatcherBasePtr m_IoThread;
+    dispatch::DispatcherBasePtr m_OutputThread;
+    std::string m_OutputBuffer;
     dispatch::DispatcherPoolPtr m_DispatchPool;
     size_t m_ActiveWorkers;
     size_t m_BlockSize = 8192;
+    size_t m_WordsPerBlock = 8192;
     std::map<size_t, uint64_t> m_LastBlockMs;
 };
 
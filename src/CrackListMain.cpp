@@ -27,6 +27,12 @@ Options:
   --blocksize <value>           Set the block size for processing.
   --sha1, --ntlm, --md5, --md4  Specify the hash algorithm to use.
   --linkedin                    Enable LinkedIn hash processing mode.
+  --rules, -r <file>            Apply the hashcat rules in the file to each word.
+  --combinator, -c <file>       Append every word of the file to each word.
+  --join, -j <string>           Join combinator words with a separator.
+  --append-mask <mask>          Append every word of a mask to each word (e.g., ?d?d?d?d).
+  --prepend-mask <mask>         Prepend every word of a mask to each word.
+  --custom1..4, -1..-4 <chars>  Define the custom mask charsets ?1 to ?4.
   --binary, -b                  Treat input hashes as binary.
   --bitmask, --masksize, -m     Set the bitmask size.
   --autohex, -a                 Automatically convert input to hexadecimal.
@@ -105,6 +111,36 @@ int main(
         {
             cracklist.SetBinary(true);
         }
+        else if (arg == "--rules" || arg == "-r")
+        {
+            ARGCHECK();
+            cracklist.SetRules(args[++i]);
+        }
+        else if (arg == "--combinator" || arg == "-c")
+        {
+            ARGCHECK();
+            cracklist.SetCombinator(args[++i]);
+        }
+        else if (arg == "--join" || arg == "-j")
+        {
+            ARGCHECK();
+            cracklist.SetJoin(args[++i]);
+        }
+        else if (arg == "--append-mask" || arg == "--prepend-mask")
+        {
+            ARGCHECK();
+            cracklist.SetHybridMask(args[++i], arg == "--prepend-mask");
+        }
+        else if (arg.size() == 2 && arg[0] == '-' && arg[1] >= '1' && arg[1] <= '4')
+        {
+            ARGCHECK();
+            cracklist.SetCustomCharset(arg[1] - '1', args[++i]);
+        }
+        else if (arg.size() == 9 && arg.starts_with("--custom") && arg[8] >= '1' && arg[8] <= '4')
+        {
+            ARGCHECK();
+            cracklist.SetCustomCharset(arg[8] - '1', args[++i]);
+        }
         else if (arg == "--bitmask" || arg == "--masksize" || arg == "-m")
         {
             ARGCHECK();
@@ -159,7 +195,10 @@ int main(
         }
     }
 
-    cracklist.Crack();
+    if (!cracklist.Crack())
+    {
+        return 1;
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,189 @@
+//
+//  DeltaEncoding.hpp
+//  CrackTools
+//
+//  Created by Kryc on 16/10/2026.
+//  Copyright © 2026 Kryc. All rights reserved.
+//
+
+#ifndef DeltaEncoding_hpp
+#define DeltaEncoding_hpp
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Check.hpp"
+
+namespace cracktools
+{
+
+// The longest encoding of a 64-bit value
+constexpr size_t kVarintMaxLength = 10;
+
+// Writes the value as a little endian base 128 varint and
+// returns the number of bytes written to the destination
+inline static size_t
+VarintEncode(
+    uint64_t Value,
+    std::span<uint8_t> Destination
+)
+{
+    CHECKA(Destination.size() >= kVarintMaxLength, "Destination too small for varint");
+    size_t length = 0;
+    while (Value >= 0x80)
+    {
+        Destination[length++] = (uint8_t)(Value | 0x80);
+        Value >>= 7;
+    }
+    Destination[length++] = (uint8_t)Value;
+    return length;
+}
+
+// Appends the value to the vector as a varint
+inline static void
+VarintAppend(
+    uint64_t Value,
+    std::vector<uint8_t>& Destination
+)
+{
+    uint8_t buffer[kVarintMaxLength];
+    const size_t length = VarintEncode(Value, buffer);
+    Destination.insert(Destination.end(), &buffer[0], &buffer[length]);
+}
+
+// Reads a varint from the source and returns the number of bytes
+// consumed, or zero if the source ends before the varint does
+inline static size_t
+VarintDecode(
+    std::span<const uint8_t> Source,
+    uint64_t& Value
+)
+{
+    Value = 0;
+    const size_t limit = std::min(Source.size(), kVarintMaxLength);
+    for (size_t i = 0; i < limit; i++)
+    {
+        Value |= (uint64_t)(Source[i] & 0x7f) << (i * 7);
+        if ((Source[i] & 0x80) == 0)
+        {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+// The number of bits needed to store values up to and including Max
+inline static size_t
+BitsRequired(
+    const uint64_t Max
+)
+{
+    return std::max<size_t>(std::bit_width(Max), 1);
+}
+
+// The number of 64-bit words needed to hold Count values of Bits each
+inline static size_t
+BitPackedWords(
+    const size_t Count,
+    const size_t Bits
+)
+{
+    return (Count * Bits + 63) / 64;
+}
+
+// Reads the value at the index from an array of fixed width values
+// packed end to end. Values may straddle two words
+inline static uint64_t
+BitPackedGet(
+    std::span<const uint64_t> Words,
+    const size_t Bits,
+    const size_t Index
+)
+{
+    const size_t bit = Index * Bits;
+    const size_t word = bit / 64;
+    const size_t shift = bit % 64;
+
+    uint64_t value = Words[word] >> shift;
+    if (shift + Bits > 64)
+    {
+        value |= Words[word + 1] << (64 - shift);
+    }
+    return Bits == 64 ? value : value & ((1ull << Bits) - 1);
+}
+
+// Builds an array of fixed width values packed end to end
+class BitPackedWriter
+{
+public:
+    BitPackedWriter(
+        const size_t Bits
+    ) : m_Bits(Bits) { CHECKA(Bits > 0 && Bits <= 64, "Invalid bit width"); }
+    void Push(
+        const uint64_t Value
+    )
+    {
+        const size_t shift = m_Bit % 64;
+        if (shift == 0)
+        {
+            m_Words.push_back(0);
+        }
+        m_Words.back() |= Value << shift;
+        if (shift + m_Bits > 64)
+        {
+            m_Words.push_back(Value >> (64 - shift));
+        }
+        m_Bit += m_Bits;
+    }
+    const size_t GetBits(void) const { return m_Bits; }
+    std::span<const uint64_t> GetWords(void) const { return m_Words; }
+private:
+    size_t m_Bits;
+    size_t m_Bit = 0;
+    std::vector<uint64_t> m_Words;
+};
+
+// Walks a block of sorted values stored as the first value followed
+// by the varint deltas between each value and the one before it
+class DeltaBlockReader
+{
+public:
+    DeltaBlockReader(
+        const uint64_t First,
+        std::span<const uint8_t> Data,
+        const size_t Count
+    ) : m_Value(First), m_Data(Data), m_Remaining(Count) {}
+    const uint64_t Value(void) const { return m_Value; }
+    // Moves to the next value, false at the end of the block
+    bool Next(void)
+    {
+        if (m_Remaining <= 1)
+        {
+            m_Remaining = 0;
+            return false;
+        }
+        uint64_t delta;
+        const size_t length = VarintDecode(m_Data, delta);
+        if (length == 0)
+        {
+            m_Remaining = 0;
+            return false;
+        }
+        m_Data = m_Data.subspan(length);
+        m_Value += delta;
+        m_Remaining--;
+        return true;
+    }
+private:
+    uint64_t m_Value;
+    std::span<const uint8_t> m_Data;
+    size_t m_Remaining;
+};
+
+} // namespace cracktools
+
+#endif /* DeltaEncoding_hpp */
@@ -0,0 +1,443 @@
+//
+//  ExternalSort.hpp
+//  CrackTools
+//
+//  Created by Kryc on 16/10/2026.
+//  Copyright © 2026 Kryc. All rights reserved.
+//
+
+#ifndef ExternalSort_hpp
+#define ExternalSort_hpp
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <queue>
+#include <span>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include "DispatchQueue.hpp"
+
+// Sorts more records than fit in memory. Records are pushed into runs
+// which, once full, are sorted on the dispatch pool and spilled to
+// temporary files. Merge then streams the records back out in order
+// with a k-way merge of the runs. If everything fits in a single run
+// nothing is written to disk.
+template <typename T, typename Compare = std::less<T>>
+class ExternalSort
+{
+    static_assert(std::is_trivially_copyable_v<T>, "External sort records are written as raw bytes");
+    // The most runs merged at once, more than this are merged in passes
+    static constexpr size_t kMaxFanIn = 128;
+    // The number of records handed to the output at a time
+    static constexpr size_t kOutputBatch = 65536;
+    // The fewest records each thread sorts when a run is sorted in memory
+    static constexpr size_t kMinSortSlice = 65536;
+public:
+    ExternalSort(
+        const std::filesystem::path& TempPrefix,
+        const size_t MemoryLimit,
+        dispatch::DispatchPoolPtr Pool = nullptr,
+        const size_t Threads = 1,
+        Compare Comparator = Compare()
+    ) : m_TempPrefix(TempPrefix),
+        m_MemoryLimit(MemoryLimit),
+        m_Pool(Pool),
+        m_Threads(Pool == nullptr ? 1 : std::max<size_t>(Threads, 1)),
+        m_Compare(Comparator)
+    {
+        // The producer fills one run while each thread sorts another
+        m_RunCapacity = std::max<size_t>(MemoryLimit / sizeof(T) / (m_Threads + 1), 1024);
+        m_Run.reserve(std::min<size_t>(m_RunCapacity, 1024 * 1024));
+    }
+    ~ExternalSort(void)
+    {
+        WaitForRuns(0);
+        for (const auto& run : m_Runs)
+        {
+            std::error_code ec;
+            std::filesystem::remove(run, ec);
+        }
+    }
+    bool Push(
+        const T& Value
+    )
+    {
+        m_Run.push_back(Value);
+        m_Count++;
+        if (m_Run.size() == m_RunCapacity)
+        {
+            return SpillRun();
+        }
+        return true;
+    }
+    bool Push(
+        std::span<const T> Values
+    )
+    {
+        for (const auto& value : Values)
+        {
+            if (!Push(value))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    // Drops records which Duplicate(Previous, Record) matches against the
+    // record before them in sorted order, keeping the first of each group
+    void SetDuplicate(
+        std::function<bool(const T&, const T&)> Duplicate
+    )
+    {
+        m_Duplicate = Duplicate;
+    }
+    // Moves the remaining sorting onto another pool, such as one which
+    // was busy while the records were pushed and is free for the merge
+    void SetPool(
+        dispatch::DispatchPoolPtr Pool,
+        const size_t Threads
+    )
+    {
+        WaitForRuns(0);
+        m_Pool = Pool;
+        m_Threads = Pool == nullptr ? 1 : std::max<size_t>(Threads, 1);
+    }
+    const size_t GetCount(void) const { return m_Count; }
+    const size_t GetRunCount(void) const { return m_Runs.size(); }
+    // The duplicates dropped so far. Runs drop their own duplicates as
+    // they are spilled, the rest are only found by the merge
+    const size_t GetDropped(void) const { return m_Dropped; }
+    // The fraction of the records in sorted runs that were duplicates
+    const double GetDuplicateRate(void) const { return m_Deduplicated == 0 ? 0.f : (double)m_Dropped / m_Deduplicated; }
+    // Streams every record in sorted order to Output as spans of
+    // records. Output returns false to abort the merge
+    template <typename OutputFn>
+    bool Merge(
+        OutputFn&& Output
+    )
+    {
+        // Everything fit in memory
+        if (m_Runs.empty())
+        {
+            SortRun(m_Run);
+            RemoveDuplicates(m_Run);
+            std::span<const T> records(m_Run);
+            for (size_t i = 0; i < records.size(); i += kOutputBatch)
+            {
+                if (!Output(records.subspan(i, std::min(kOutputBatch, records.size() - i))))
+                {
+                    return false;
+                }
+            }
+            m_Run.clear();
+            return true;
+        }
+
+        if (!m_Run.empty() && !SpillRun())
+        {
+            return false;
+        }
+        m_Run = std::vector<T>();
+        WaitForRuns(0);
+
+        // Merge in passes until few enough runs remain
+        // to be merged at once, each group in parallel
+        while (!m_Failed && m_Runs.size() > kMaxFanIn)
+        {
+            std::vector<std::filesystem::path> runs;
+            runs.swap(m_Runs);
+            for (size_t i = 0; i < runs.size(); i += kMaxFanIn)
+            {
+                auto group = std::make_shared<std::vector<std::filesystem::path>>(
+                    runs.begin() + i,
+                    runs.begin() + std::min(i + kMaxFanIn, runs.size())
+                );
+                auto path = NextRunPath();
+                m_Runs.push_back(path);
+                Dispatch([this, group, path]() {
+                    return MergeToFile(*group, path);
+                });
+            }
+            WaitForRuns(0);
+        }
+
+        if (m_Failed)
+        {
+            return false;
+        }
+
+        return MergeRuns(m_Runs, m_MemoryLimit, Output);
+    }
+private:
+    // Runs the task on the pool, waiting if every thread is busy
+    void Dispatch(
+        std::function<bool(void)> Task
+    )
+    {
+        if (m_Pool == nullptr)
+        {
+            m_Failed = m_Failed || !Task();
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(m_Lock);
+        m_Done.wait(lock, [this]() { return m_InFlight < m_Threads; });
+        m_InFlight++;
+        lock.unlock();
+
+        m_Pool->PostTask([this, Task]() {
+            const bool success = Task();
+            std::lock_guard<std::mutex> guard(m_Lock);
+            m_Failed = m_Failed || !success;
+            m_InFlight--;
+            m_Done.notify_all();
+        });
+    }
+    void WaitForRuns(
+        const size_t MaxInFlight
+    )
+    {
+        std::unique_lock<std::mutex> lock(m_Lock);
+        m_Done.wait(lock, [this, MaxInFlight]() { return m_InFlight <= MaxInFlight; });
+    }
+    // Sorts a run held in memory. With a pool it is sorted in slices,
+    // one per thread, which are then merged pairwise in parallel rounds
+    void SortRun(
+        std::vector<T>& Run
+    )
+    {
+        const size_t slices = std::min(m_Threads, Run.size() / kMinSortSlice);
+        if (m_Pool == nullptr || slices <= 1)
+        {
+            std::sort(Run.begin(), Run.end(), m_Compare);
+            return;
+        }
+
+        std::vector<size_t> bounds(slices + 1);
+        for (size_t i = 0; i <= slices; i++)
+        {
+            bounds[i] = Run.size() * i / slices;
+        }
+
+        for (size_t i = 0; i < slices; i++)
+        {
+            auto begin = Run.begin() + bounds[i];
+            auto end = Run.begin() + bounds[i + 1];
+            Dispatch([this, begin, end]() {
+                std::sort(begin, end, m_Compare);
+                return true;
+            });
+        }
+        WaitForRuns(0);
+
+        for (size_t width = 1; width < slices; width *= 2)
+        {
+            for (size_t i = 0; i + width < slices; i += 2 * width)
+            {
+                auto begin = Run.begin() + bounds[i];
+                auto middle = Run.begin() + bounds[i + width];
+                auto end = Run.begin() + bounds[std::min(i + 2 * width, slices)];
+                Dispatch([this, begin, middle, end]() {
+                    std::inplace_merge(begin, middle, end, m_Compare);
+                    return true;
+                });
+            }
+            WaitForRuns(0);
+        }
+    }
+    void RemoveDuplicates(
+        std::vector<T>& Run
+    )
+    {
+        if (m_Duplicate)
+        {
+            const auto end = std::unique(Run.begin(), Run.end(), m_Duplicate);
+            m_Deduplicated += Run.size();
+            m_Dropped += Run.end() - end;
+            Run.erase(end, Run.end());
+        }
+    }
+    std::filesystem::path NextRunPath(void)
+    {
+        return std::filesystem::path(m_TempPrefix).concat("." + std::to_string(m_NextRun++));
+    }
+    bool SpillRun(void)
+    {
+        auto run = std::make_shared<std::vector<T>>(std::move(m_Run));
+        m_Run = std::vector<T>();
+        m_Run.reserve(std::min<size_t>(m_RunCapacity, 1024 * 1024));
+
+        auto path = NextRunPath();
+        m_Runs.push_back(path);
+        Dispatch([this, run, path]() {
+            std::sort(run->begin(), run->end(), m_Compare);
+            RemoveDuplicates(*run);
+            FILE* handle = fopen(path.c_str(), "wb");
+            if (handle == nullptr)
+            {
+                return false;
+            }
+            bool success = fwrite(run->data(), sizeof(T), run->size(), handle) == run->size();
+            success = fclose(handle) == 0 && success;
+            run->clear();
+            run->shrink_to_fit();
+            return success;
+        });
+        return !m_Failed;
+    }
+    bool MergeToFile(
+        std::span<const std::filesystem::path> Runs,
+        const std::filesystem::path& Path
+    )
+    {
+        FILE* handle = fopen(Path.c_str(), "wb");
+        if (handle == nullptr)
+        {
+            return false;
+        }
+        bool success = MergeRuns(Runs, m_MemoryLimit / m_Threads, [handle](std::span<const T> Records) {
+            return fwrite(Records.data(), sizeof(T), Records.size(), handle) == Records.size();
+        });
+        success = fclose(handle) == 0 && success;
+        return success;
+    }
+    // K-way merges the sorted run files and removes them afterwards
+    template <typename OutputFn>
+    bool MergeRuns(
+        std::span<const std::filesystem::path> Runs,
+        const size_t Memory,
+        OutputFn&& Output
+    )
+    {
+        struct RunReader
+        {
+            FILE* handle;
+            std::vector<T> buffer;
+            size_t position;
+            size_t remaining;
+        };
+
+        const size_t bufferRecords = std::clamp<size_t>(Memory / sizeof(T) / (Runs.size() + 1), 1024, 1024 * 1024);
+        std::vector<RunReader> readers(Runs.size());
+        bool success = true;
+
+        // Each run is read to exactly the records its file holds, a short
+        // read is an error rather than the end of the run
+        auto refill = [&](RunReader& Reader) {
+            const size_t count = std::min(bufferRecords, Reader.remaining);
+            Reader.buffer.resize(count);
+            const size_t read = fread(Reader.buffer.data(), sizeof(T), count, Reader.handle);
+            if (read != count)
+            {
+                success = false;
+            }
+            Reader.buffer.resize(read);
+            Reader.position = 0;
+            Reader.remaining -= count;
+            return read > 0;
+        };
+
+        // The heap keeps the reader with the smallest current record on top
+        auto greater = [&](const size_t A, const size_t B) {
+            return m_Compare(readers[B].buffer[readers[B].position], readers[A].buffer[readers[A].position]);
+        };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+
+        for (size_t i = 0; i < Runs.size() && success; i++)
+        {
+            std::error_code ec;
+            const size_t size = std::filesystem::file_size(Runs[i], ec);
+            readers[i].handle = fopen(Runs[i].c_str(), "rb");
+            if (ec || size % sizeof(T) != 0 || readers[i].handle == nullptr)
+            {
+                success = false;
+                break;
+            }
+            readers[i].remaining = size / sizeof(T);
+            if (refill(readers[i]))
+            {
+                heap.push(i);
+            }
+        }
+
+        std::vector<T> output;
+        output.reserve(kOutputBatch);
+        std::optional<T> last;
+        size_t dropped = 0;
+        while (success && !heap.empty())
+        {
+            const size_t next = heap.top();
+            heap.pop();
+
+            RunReader& reader = readers[next];
+            const T& record = reader.buffer[reader.position++];
+            if (m_Duplicate && last.has_value() && m_Duplicate(*last, record))
+            {
+                dropped++;
+            }
+            else
+            {
+                output.push_back(record);
+                last = record;
+            }
+            if (reader.position < reader.buffer.size() || refill(reader))
+            {
+                heap.push(next);
+            }
+
+            if (output.size() == kOutputBatch)
+            {
+                success = Output(std::span<const T>(output));
+                output.clear();
+            }
+        }
+
+        if (success && !output.empty())
+        {
+            success = Output(std::span<const T>(output));
+        }
+        m_Dropped += dropped;
+
+        for (size_t i = 0; i < Runs.size(); i++)
+        {
+            if (readers[i].handle != nullptr)
+            {
+                fclose(readers[i].handle);
+            }
+            std::error_code ec;
+            std::filesystem::remove(Runs[i], ec);
+        }
+
+        return success;
+    }
+
+    std::filesystem::path m_TempPrefix;
+    size_t m_MemoryLimit;
+    dispatch::DispatchPoolPtr m_Pool;
+    size_t m_Threads;
+    Compare m_Compare;
+    size_t m_RunCapacity;
+    std::vector<T> m_Run;
+    std::vector<std::filesystem::path> m_Runs;
+    size_t m_NextRun = 0;
+    size_t m_Count = 0;
+    std::function<bool(const T&, const T&)> m_Duplicate;
+    std::atomic<size_t> m_Dropped = 0;
+    std::atomic<size_t> m_Deduplicated = 0;
+    std::mutex m_Lock;
+    std::condition_variable m_Done;
+    size_t m_InFlight = 0;
+    std::atomic<bool> m_Failed = false;
+};
+
+#endif /* ExternalSort_hpp */
@@ -0,0 +1,96 @@
+//
+//  LineScanner.cpp
+//  CrackList
+//
+//  Created by Kryc on 16/10/2026.
+//  Copyright © 2026 Kryc. All rights reserved.
+//
+
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX512BW__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "LineScanner.hpp"
+
+namespace LineScanner
+{
+
+// Appends the offset of every set bit in a
+// compare mask where bit n stands for byte n
+template <typename T>
+static inline void
+AppendMask(
+    T Mask,
+    const size_t Base,
+    std::vector<uint32_t>& Newlines
+)
+{
+    while (Mask != 0)
+    {
+        Newlines.push_back(Base + std::countr_zero(Mask));
+        Mask &= Mask - 1;
+    }
+}
+
+void
+FindNewlines(
+    std::string_view Data,
+    std::vector<uint32_t>& Newlines
+)
+{
+    const char* data = Data.data();
+    const size_t size = Data.size();
+    size_t i = 0;
+
+#if defined(__AVX512BW__)
+    const __m512i newline512 = _mm512_set1_epi8('\n');
+    for (; i + 64 <= size; i += 64)
+    {
+        const __m512i bytes = _mm512_loadu_si512(data + i);
+        AppendMask((uint64_t)_mm512_cmpeq_epi8_mask(bytes, newline512), i, Newlines);
+    }
+#endif
+
+#if defined(__AVX2__)
+    const __m256i newline256 = _mm256_set1_epi8('\n');
+    for (; i + 32 <= size; i += 32)
+    {
+        const __m256i bytes = _mm256_loadu_si256((const __m256i*)(data + i));
+        AppendMask((uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(bytes, newline256)), i, Newlines);
+    }
+#endif
+
+    if constexpr (std::endian::native == std::endian::little)
+    {
+        // Bytes equal to the newline become zero after the xor, and the
+        // add then leaves only those without their top bit set. Unlike
+        // the usual subtract trick this never flags the byte after a match
+        constexpr uint64_t kOnes = 0x0101010101010101ull;
+        constexpr uint64_t kLow = 0x7f7f7f7f7f7f7f7full;
+        for (; i + 8 <= size; i += 8)
+        {
+            uint64_t word;
+            memcpy(&word, data + i, sizeof(word));
+            const uint64_t x = word ^ (kOnes * '\n');
+            uint64_t matches = ~(((x & kLow) + kLow) | x | kLow);
+            while (matches != 0)
+            {
+                Newlines.push_back(i + std::countr_zero(matches) / 8);
+                matches &= matches - 1;
+            }
+        }
+    }
+
+    for (; i < size; i++)
+    {
+        if (data[i] == '\n')
+        {
+            Newlines.push_back(i);
+        }
+    }
+}
+
+}
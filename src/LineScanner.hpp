@@ -0,0 +1,30 @@
+//
+//  LineScanner.hpp
+//  CrackList
+//
+//  Created by Kryc on 16/10/2026.
+//  Copyright © 2026 Kryc. All rights reserved.
+//
+
+#ifndef LineScanner_hpp
+#define LineScanner_hpp
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace LineScanner
+{
+
+// Appends the offset of every newline in Data, relative to its start.
+// Uses AVX-512 or AVX2 compares when built for them and otherwise tests
+// eight bytes at a time, so no byte is looked at on its own
+void
+FindNewlines(
+    std::string_view Data,
+    std::vector<uint32_t>& Newlines
+);
+
+}
+
+#endif /* LineScanner_hpp */
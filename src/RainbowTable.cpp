@@ -13,6 +13,7 @@
 #include <format>
 #include <iomanip>
 #include <iostream>
+#include <latch>
 #include <mutex>
 #include <optional>
 #include <string>
@@ -27,6 +28,20 @@
 #include "SmallString.hpp"
 #include "Util.hpp"
 
+// The build status is redrawn at most this often
+constexpr auto kStatusInterval = std::chrono::milliseconds(100);
+
+// Orders records by endpoint, breaking ties by startpoint
+// so that sorting a table always gives the same result
+static bool
+EndpointOrder(
+    const TableRecord& A,
+    const TableRecord& B
+)
+{
+    return A.endpoint < B.endpoint || (A.endpoint == B.endpoint && A.startpoint < B.startpoint);
+}
+
 /* static */ const size_t
 RainbowTable::ChainWidthForType(
     const TableType Type,
@@ -36,7 +51,7 @@ RainbowTable::ChainWidthForType(
     return Type == TypeCompressed ? sizeof(TableRecordCompressed) : sizeof(TableRecord);
 }
 
-void
+bool
 RainbowTable::InitAndRunBuild(
     void
 )
@@ -50,7 +65,7 @@ RainbowTable::InitAndRunBuild(
     if (!ValidateConfig())
     {
         std::cerr << "Configuration error" << std::endl;
-        return;
+        return false;
     }
 
     m_Operation = "Building";
@@ -85,11 +100,54 @@ RainbowTable::InitAndRunBuild(
 
     m_StartingChains = m_Chains;
 
-    m_WriteHandle = fopen(m_Path.c_str(), "a");
+    // Blocks and delta tables are written in place with pwrite,
+    // which ignores the offset of handles opened for append
+    m_WriteHandle = fopen(m_Path.c_str(), "r+");
     if (m_WriteHandle == nullptr)
     {
         std::cerr << "Unable to open table for writing" << std::endl;
-        return;
+        return false;
+    }
+    fseek(m_WriteHandle, 0, SEEK_END);
+
+    // Sorted builds spill the chains as sorted runs while the
+    // build runs and merge them into the table at the end
+    if (m_SortedBuild)
+    {
+        // Sorting a run costs little next to generating its chains, so a
+        // single thread keeps up with the spills while the build pool has
+        // every core. The merge moves onto the build pool once it is idle
+        if (m_Threads > 1)
+        {
+            m_SortPool = dispatch::CreateDispatchPool("sort", 1);
+        }
+        m_BuildSort = std::make_unique<ExternalSort<TableRecord, TableRecordCompare>>(
+            std::filesystem::path(m_Path).concat(".sort"),
+            GetSortMemory(),
+            m_SortPool,
+            1,
+            EndpointOrder
+        );
+
+        // Chains which merge into the same endpoint cover mostly the
+        // same points, perfect tables keep only the first of them
+        if (m_Perfect)
+        {
+            m_BuildSort->SetDuplicate([](const TableRecord& A, const TableRecord& B) {
+                return A.endpoint == B.endpoint;
+            });
+        }
+    }
+    else if (!OpenJournal())
+    {
+        std::cerr << "Unable to open build journal" << std::endl;
+        return false;
+    }
+
+    // Appending chains invalidates any existing endpoint index
+    if (IndexExists())
+    {
+        std::filesystem::remove(GetIndexPath());
     }
 
     // Create the main (io) dispatcher
@@ -108,7 +166,6 @@ RainbowTable::InitAndRunBuild(
                 dispatch::bind(
                     &RainbowTable::GenerateBlock,
                     this,
-                    i,
                     i
                 )
             );
@@ -120,7 +177,6 @@ RainbowTable::InitAndRunBuild(
             dispatch::bind(
                 &RainbowTable::GenerateBlock,
                 this,
-                0,
                 0
             )
         );
@@ -130,18 +186,22 @@ RainbowTable::InitAndRunBuild(
     mainDispatcher->Wait();
 
     std::cout << std::endl;
+
+    return !m_WriteFailed;
 }
 
 void
 RainbowTable::GenerateBlock(
-    const size_t ThreadId,
-    const size_t BlockId
+    const size_t ThreadId
 )
 {
+    // Threads claim the next block as they finish their last,
+    // so faster threads get through more of the table
+    const size_t BlockId = m_NextBlock++;
     size_t blockStartId = m_StartingChains + (m_Blocksize * BlockId);
 
-    // Check if we should end
-    if (blockStartId >= m_Count)
+    // Check if we should end, a failed write ends the build early
+    if (m_WriteFailed || blockStartId >= m_Count)
     {
         dispatch::PostTaskToDispatcher(
             "main",
@@ -154,10 +214,23 @@ RainbowTable::GenerateBlock(
         return;
     }
 
+    // Skip blocks written before the build was interrupted
+    if (m_JournalBlocks.contains(blockStartId))
+    {
+        dispatch::PostTaskFast(
+            dispatch::bind(
+                &RainbowTable::GenerateBlock,
+                this,
+                ThreadId
+            )
+        );
+        return;
+    }
+
     WordGenerator wordGenerator(m_Charset);
     wordGenerator.GenerateParsingLookupTable();
     HybridReducer reducer(m_Min, m_Max, m_Charset);
-    std::vector<TableRecord> block(m_Blocksize);
+    std::vector<TableRecord> block = AcquireBlock();
 
     SimdHashBufferFixed<kSmallStringMaxLength> words;
     std::array<uint8_t, MAX_HASH_SIZE * MAX_LANES> hashBuffer;
@@ -169,6 +242,10 @@ RainbowTable::GenerateBlock(
 #else
     uint64_t counter = CalculateLowerBound() + blockStartId;
 #endif
+    // Start points are consecutive so they are stepped through
+    // rather than generated from the counter each time
+    WordOdometer startpoints(m_Charset);
+    startpoints.Seek(counter);
     const size_t hashWidth = m_HashWidth;
     const size_t lanes = SimdLanes();
 
@@ -181,7 +258,7 @@ RainbowTable::GenerateBlock(
         // Set the chain start point
         for (size_t i = 0; i < lanes; i++)
         {
-            const size_t length = wordGenerator.Generate(words.GetBufferChar(i), counter++);
+            const size_t length = startpoints.Next(words.GetBufferChar(i));
             words.SetLength(i, length);
         }
 
@@ -220,30 +297,24 @@ RainbowTable::GenerateBlock(
 
     //
     // Post a task to the main thread
-    // to save this block
+    // to save this block. The block is
+    // moved through so it can be reused
     //
     dispatch::PostTaskToDispatcher(
         "main",
-        dispatch::bind(
-            &RainbowTable::SaveBlock,
-            this,
-            ThreadId,
-            BlockId,
-            std::move(block),
-            elapsed_ms.count()
-        )
+        [this, ThreadId, BlockId, block = std::move(block), time = elapsed_ms.count()]() mutable {
+            SaveBlock(ThreadId, BlockId, std::move(block), time);
+        }
     );
 
     //
     // Post the next task
     //
-    const size_t nextblock = BlockId + m_Threads;
     dispatch::PostTaskFast(
         dispatch::bind(
             &RainbowTable::GenerateBlock,
             this,
-            ThreadId,
-            nextblock
+            ThreadId
         )
     );
 }
@@ -254,24 +325,44 @@ RainbowTable::WriteBlock(
     std::span<const TableRecord> Block
 )
 {
-    // For uncompressed, we can just write the block
-    if (m_TableType == TypeUncompressed)
+    // Sorted builds hold the chains until the build completes.
+    // Failed spills are reported when the runs are merged
+    if (m_BuildSort != nullptr)
     {
-        fwrite(Block.data(), Block.size_bytes(), sizeof(uint8_t), m_WriteHandle);
-        fflush(m_WriteHandle);
+        m_BuildSort->Push(Block);
+        m_ChainsWritten += Block.size();
+        return;
     }
+
+    // For uncompressed, we can just write the block
+    std::span<const uint8_t> data = cracktools::AsBytes(Block);
+
     // For compressed, we need to reform the data into a single block
-    else
+    if (m_TableType == TypeCompressed)
     {
-        std::vector<TableRecordCompressed> compressedBlock(Block.size());
-        std::span<TableRecordCompressed> compressedBlockSpan(compressedBlock);
+        m_CompressedBlock.resize(Block.size());
         for (size_t i = 0; i < Block.size(); i++)
         {
-            compressedBlock[i] = Block[i];
+            m_CompressedBlock[i] = Block[i];
         }
-        fwrite(compressedBlockSpan.data(), compressedBlockSpan.size_bytes(), sizeof(uint8_t), m_WriteHandle);
-        fflush(m_WriteHandle);
+        data = cracktools::AsBytes(std::span<const TableRecordCompressed>(m_CompressedBlock));
+    }
+
+    // Blocks go straight to their place in the table
+    const size_t blockStartId = m_StartingChains + (m_Blocksize * BlockId);
+    const size_t offset = sizeof(TableHeader) + blockStartId * GetChainWidth();
+    if (pwrite(fileno(m_WriteHandle), data.data(), data.size(), offset) != (ssize_t)data.size())
+    {
+        std::cerr << std::endl << "Error writing block " << BlockId << " to table" << std::endl;
+        m_WriteFailed = true;
+        return;
     }
+
+    // Only journal the block once its chains are in the table
+    const JournalEntry entry = { blockStartId, Block.size() };
+    fwrite(&entry, sizeof(entry), 1, m_JournalHandle);
+    fflush(m_JournalHandle);
+
     m_ChainsWritten += Block.size();
     return;
 }
@@ -283,14 +374,13 @@ RainbowTable::OutputStatus(
 {
     assert(dispatch::CurrentDispatcher() == dispatch::GetDispatcher("main").get());
 
-    uint64_t averageMs = 0;
+    // Threads run at different speeds so the
+    // overall rate is the sum of their rates
+    double chainsPerSec = 0.f;
     for (auto const& [thread, val] : m_ThreadTimers)
     {
-        averageMs += val;
+        chainsPerSec += 1000.f * m_Blocksize / std::max<uint64_t>(val, 1);
     }
-    averageMs /= m_Threads;
-
-    double chainsPerSec = 1000.f * m_Blocksize / averageMs;
     double hashesPerSec = chainsPerSec * m_Length;
 
     std::string cpsChar, hpsChar;
@@ -305,8 +395,15 @@ RainbowTable::OutputStatus(
 
     const std::string lastEndpointString(LastEndpoint);
 
+    // The rate of merged chains seen in the runs sorted so far
+    std::string merged;
+    if (m_Perfect && m_BuildSort != nullptr)
+    {
+        merged = std::format(" M:{:.1f}%", m_BuildSort->GetDuplicateRate() * 100.f);
+    }
+
     std::string status = std::format(
-        "C:{:.1f}{}({:.1f}%) C/s:{:.1f}{} H/s:{:.1f}{} E:\"{}\"",
+        "C:{:.1f}{}({:.1f}%) C/s:{:.1f}{} H/s:{:.1f}{}{} E:\"{}\"",
         chains,
         chainsChar,
         percent,
@@ -314,6 +411,7 @@ RainbowTable::OutputStatus(
         cpsChar,
         hashesPerSec,
         hpsChar,
+        merged,
         lastEndpointString
     );
 
@@ -337,32 +435,128 @@ void
 RainbowTable::SaveBlock(
     const size_t ThreadId,
     const size_t BlockId,
-    const std::vector<TableRecord> Block,
+    std::vector<TableRecord> Block,
     const uint64_t Time
 )
 {
     m_ThreadTimers[ThreadId] = Time;
+    m_LastEndpoint = Block[0].endpoint;
+
+    // Redrawing the status for every block holds up the writes
+    const auto now = std::chrono::steady_clock::now();
+    if (now - m_LastStatus >= kStatusInterval)
+    {
+        m_LastStatus = now;
+        OutputStatus(WordGenerator::GenerateWord(m_LastEndpoint, m_Charset));
+    }
 
-    // Generate the string for the first endpoint
-    auto endpoint = WordGenerator::GenerateWord(Block[0].endpoint, m_Charset);
+    // Blocks are written in the order they complete
+    WriteBlock(BlockId, Block);
+    ReleaseBlock(std::move(Block));
+}
+
+// Hands out a block for a worker to fill, reusing one already written
+// if there is one. Workers wait here while kBlocksInFlight blocks per
+// thread are still to be written, so a writer that falls behind holds
+// back the build rather than queueing blocks without limit
+std::vector<TableRecord>
+RainbowTable::AcquireBlock(
+    void
+)
+{
+    std::unique_lock<std::mutex> lock(m_BlockLock);
+    m_BlockReleased.wait(lock, [this]() { return m_BlocksInFlight < kBlocksInFlight * m_Threads; });
+    m_BlocksInFlight++;
+
+    if (m_FreeBlocks.empty())
+    {
+        return std::vector<TableRecord>(m_Blocksize);
+    }
 
-    OutputStatus(endpoint);
+    std::vector<TableRecord> block = std::move(m_FreeBlocks.back());
+    m_FreeBlocks.pop_back();
+    return block;
+}
+
+void
+RainbowTable::ReleaseBlock(
+    std::vector<TableRecord> Block
+)
+{
+    std::lock_guard<std::mutex> lock(m_BlockLock);
+    m_FreeBlocks.push_back(std::move(Block));
+    m_BlocksInFlight--;
+    m_BlockReleased.notify_one();
+}
+
+// Starts the journal of written blocks. Resumed builds read it back to
+// continue after the blocks written in order and skip any written
+// beyond them, which must have the same block size to be recognised
+bool
+RainbowTable::OpenJournal(
+    void
+)
+{
+    const auto journalPath = GetJournalPath();
+    const bool resume = m_PathLoaded && std::filesystem::exists(journalPath);
 
-    if (BlockId == m_NextWriteBlock)
+    std::vector<JournalEntry> entries;
+    if (resume)
     {
-        WriteBlock(BlockId, Block);
-        m_NextWriteBlock++;
-        while (m_WriteCache.find(m_NextWriteBlock) != m_WriteCache.end())
+        FILE* handle = fopen(journalPath.c_str(), "r");
+        if (handle == nullptr)
+        {
+            return false;
+        }
+        JournalEntry entry;
+        while (fread(&entry, sizeof(entry), 1, handle) == 1)
         {
-            WriteBlock(m_NextWriteBlock, m_WriteCache.at(m_NextWriteBlock));
-            m_WriteCache.erase(m_NextWriteBlock);
-            m_NextWriteBlock++;
+            entries.push_back(entry);
         }
+        fclose(handle);
     }
-    else
+
+    m_JournalHandle = fopen(journalPath.c_str(), resume ? "a" : "w");
+    if (m_JournalHandle == nullptr)
+    {
+        return false;
+    }
+
+    if (!resume)
+    {
+        const JournalEntry existing = { 0, m_StartingChains };
+        fwrite(&existing, sizeof(existing), 1, m_JournalHandle);
+        fflush(m_JournalHandle);
+        return true;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const JournalEntry& A, const JournalEntry& B) {
+        return A.start < B.start;
+    });
+
+    size_t completed = 0;
+    for (const auto& entry : entries)
     {
-        m_WriteCache.emplace(BlockId, std::move(Block));
+        if (entry.start > completed)
+        {
+            break;
+        }
+        completed = std::max<size_t>(completed, entry.start + entry.count);
+    }
+
+    for (const auto& entry : entries)
+    {
+        if (entry.start > completed && entry.count == m_Blocksize && (entry.start - completed) % m_Blocksize == 0)
+        {
+            m_JournalBlocks.insert(entry.start);
+            m_ChainsWritten += entry.count;
+        }
     }
+
+    m_StartingChains = completed;
+    std::cerr << "Resuming after " << completed << " chains, skipping " << m_JournalBlocks.size() << " written blocks" << std::endl;
+
+    return true;
 }
 
 bool
@@ -378,6 +572,10 @@ RainbowTable::SetType(
     {
         SetType(TypeUncompressed);
     }
+    else if (Type == "delta")
+    {
+        SetType(TypeDelta);
+    }
     else
     {
         SetType(TypeInvalid);
@@ -386,6 +584,24 @@ RainbowTable::SetType(
     return true;
 }
 
+std::string
+RainbowTable::GetType(
+    void
+) const
+{
+    switch (m_TableType)
+    {
+    case TypeUncompressed:
+        return "Uncompressed";
+    case TypeCompressed:
+        return "Compressed";
+    case TypeDelta:
+        return "Delta";
+    default:
+        return "Invalid";
+    }
+}
+
 float
 RainbowTable::GetCoverage(
     void
@@ -487,10 +703,34 @@ RainbowTable::LoadTable(
     std::string_view charset(hdr.charset, hdr.charsetlen);
     m_Charset = charset;
     m_HashWidth = GetHashWidth(m_Algorithm);
-    m_Chains = (std::filesystem::file_size(m_Path) - sizeof(TableHeader)) / GetChainWidth();
+
+    // Delta tables have no fixed chain width, they record the count
+    if (m_TableType == TypeDelta)
+    {
+        if (!LoadDeltaHeader())
+        {
+            return false;
+        }
+        m_Chains = m_DeltaHeader.count;
+    }
+    else
+    {
+        m_Chains = (std::filesystem::file_size(m_Path) - sizeof(TableHeader)) / GetChainWidth();
+    }
+
+    // The endpoints are word indexes so they lie within the keyspace
+    HybridReducer reducer(m_Min, m_Max, m_Charset);
+#ifdef BIGINT
+    const mpz_class maxIndex = reducer.GetMaxIndex();
+    m_EndpointMin = reducer.GetMinIndex().get_ui();
+    m_EndpointMax = maxIndex.fits_ulong_p() ? maxIndex.get_ui() : std::numeric_limits<uint64_t>::max();
+#else
+    m_EndpointMin = reducer.GetMinIndex();
+    m_EndpointMax = reducer.GetMaxIndex();
+#endif
 
     size_t dataSize = fileSize - sizeof(TableHeader);
-    if (dataSize % GetChainWidth() != 0)
+    if (m_TableType != TypeDelta && dataSize % GetChainWidth() != 0)
     {
         std::cerr << "Invalid or currupt table file. Data not a multiple of chain width" << std::endl;
         return false;
@@ -499,12 +739,44 @@ RainbowTable::LoadTable(
     return true;
 }
 
+bool
+RainbowTable::LoadDeltaHeader(
+    void
+)
+{
+    std::ifstream fs(m_Path, std::ios::binary);
+    fs.seekg(sizeof(TableHeader));
+    fs.read((char*)&m_DeltaHeader, sizeof(DeltaHeader));
+    if (!fs)
+    {
+        std::cerr << "Error reading delta table header" << std::endl;
+        return false;
+    }
+
+    const DeltaHeader& hdr = m_DeltaHeader;
+    if (hdr.blockchains == 0 || hdr.startbits == 0 || hdr.startbits > 64 ||
+        hdr.blocks != (hdr.count + hdr.blockchains - 1) / hdr.blockchains ||
+        hdr.startwords != cracktools::BitPackedWords(hdr.count, hdr.startbits) ||
+        std::filesystem::file_size(m_Path) != sizeof(TableHeader) + sizeof(DeltaHeader) +
+            hdr.blocks * sizeof(DeltaBlock) + hdr.startwords * sizeof(uint64_t) + hdr.databytes)
+    {
+        std::cerr << "Invalid or currupt delta table file" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 const size_t
 RainbowTable::GetCount(
     void
 ) const
 {
-    if (m_MappedTableRecords.size() > 0)
+    if (m_TableType == TypeDelta)
+    {
+        return m_DeltaHeader.count;
+    }
+    else if (m_MappedTableRecords.size() > 0)
     {
         return m_MappedTableRecords.size();
     }
@@ -528,6 +800,11 @@ RainbowTable::ValidateConfig(
 
     if (TableExists())
     {
+        if (m_SortedBuild)
+        {
+            std::cerr << "Sorted builds cannot resume an existing table" << std::endl;
+            return false;
+        }
         LoadTable();
         m_PathLoaded = true;
     }
@@ -597,6 +874,24 @@ RainbowTable::ValidateConfig(
         return false;
     }
 
+    if (m_TableType == TypeDelta && !m_SortedBuild)
+    {
+        std::cerr << "Delta tables can only be built sorted or created from an existing table" << std::endl;
+        return false;
+    }
+
+    if (m_TableType == TypeCompressed && m_SortedBuild)
+    {
+        std::cerr << "Sorted builds require an uncompressed or delta table" << std::endl;
+        return false;
+    }
+
+    if (m_Perfect && !m_SortedBuild)
+    {
+        std::cerr << "Perfect tables can only be built sorted" << std::endl;
+        return false;
+    }
+
     if (m_Blocksize == 0)
     {
         std::cerr << "No block size specified" << std::endl;
@@ -626,6 +921,19 @@ RainbowTable::BuildThreadCompleted(
     m_ThreadsCompleted++;
     if (m_ThreadsCompleted == m_Threads)
     {
+        // Redraw the status for the last blocks written
+        if (m_ChainsWritten > 0)
+        {
+            OutputStatus(WordGenerator::GenerateWord(m_LastEndpoint, m_Charset));
+        }
+
+        // Every worker has finished so the pool is free to sort with
+        if (m_BuildSort != nullptr && !WriteSortedBuild())
+        {
+            std::cerr << std::endl << "Error writing sorted table" << std::endl;
+            m_WriteFailed = true;
+        }
+
         // Stop the pool
         if (m_DispatchPool != nullptr)
         {
@@ -633,6 +941,36 @@ RainbowTable::BuildThreadCompleted(
             m_DispatchPool->Wait();
         }
 
+        if (fclose(m_WriteHandle) != 0)
+        {
+            std::cerr << std::endl << "Error closing table" << std::endl;
+            m_WriteFailed = true;
+        }
+        m_WriteHandle = nullptr;
+
+        // Every block is in the table so the journal is done with. After a
+        // failed write it is kept so resuming writes the missing blocks
+        if (m_JournalHandle != nullptr)
+        {
+            fclose(m_JournalHandle);
+            m_JournalHandle = nullptr;
+            if (m_WriteFailed)
+            {
+                std::cerr << std::endl << "Table is incomplete, resume the build to finish it" << std::endl;
+            }
+            else
+            {
+                std::filesystem::remove(GetJournalPath());
+            }
+        }
+
+        // Compressed tables need an endpoint index to be searchable
+        if (!m_WriteFailed && m_TableType == TypeCompressed && m_UseIndex)
+        {
+            std::cerr << std::endl;
+            BuildIndex();
+        }
+
         // Stop the current (main) dispatcher
         dispatch::CurrentDispatcher()->Stop();
     }
@@ -643,95 +981,684 @@ RainbowTable::UnmapTable(
     void
 )
 {
-    return cracktools::UnmapFileSpan(m_MappedTable, m_MappedTableFd);
+    UnmapIndex();
     m_MappedTableRecords = std::span<TableRecord>();
     m_MappedTableRecordsCompressed = std::span<TableRecordCompressed>();
+    m_DeltaBlocks = std::span<const DeltaBlock>();
+    m_DeltaStartpoints = std::span<const uint64_t>();
+    m_DeltaData = std::span<const uint8_t>();
+    return cracktools::UnmapFileSpan(m_MappedTable, m_MappedTableFd);
 }
 
 bool
-RainbowTable::MapTable(
-    const bool ReadOnly
+RainbowTable::UnmapIndex(
+    void
 )
 {
-    // Check if it is already mapped
-    if (TableMapped())
+    m_MappedIndex32 = std::span<const uint32_t>();
+    m_MappedIndex64 = std::span<const uint64_t>();
+    return cracktools::UnmapFileSpan(m_MappedIndex, m_MappedIndexFd);
+}
+
+bool
+RainbowTable::MapIndex(
+    void
+)
+{
+    if (TableIndexed())
     {
-        if (m_MappedReadOnly == ReadOnly)
-        {
-            return true;
-        }
-        // Unmap it to remap writable
-        if (!UnmapTable())
-        {
-            std::cerr << "Unmapping table failed" << std::endl;
-            return false;
-        }
+        return true;
     }
 
-    int flags = ReadOnly ? MAP_PRIVATE : MAP_SHARED;
-    int prot = ReadOnly ? PROT_READ : (PROT_READ | PROT_WRITE);
-    auto mapping = cracktools::MmapFileSpan<uint8_t>(m_Path, prot, flags, /*madvise*/ true);
+    if (!IndexExists())
+    {
+        return false;
+    }
 
+    auto mapping = cracktools::MmapFileSpan<uint8_t>(GetIndexPath(), PROT_READ, MAP_PRIVATE, /*madvise*/ !m_AdviseLookups);
     if (!mapping.has_value())
     {
-        std::cerr << "Error: unable to map table file " << m_Path.filename() << std::endl;
+        std::cerr << "Error: unable to map table index " << GetIndexPath().filename() << std::endl;
         return false;
     }
 
     auto [mapped, fp] = mapping.value();
 
-    m_MappedTable = mapped;
-    m_MappedTableFd = fp;
-    
-    auto subspan_data = m_MappedTable.subspan(sizeof(TableHeader));
-    if (m_TableType == TypeCompressed)
+    IndexHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    if (mapped.size() >= sizeof(IndexHeader))
     {
-        
-        if (subspan_data.size() % sizeof(TableRecordCompressed) != 0)
-        {
-            std::cerr << "Invalid or currupt table file. Data not a multiple of chain width" << std::endl;
-            return false;
-        }
-        m_MappedTableRecordsCompressed = cracktools::SpanCast<TableRecordCompressed>(subspan_data);
+        memcpy(&hdr, mapped.data(), sizeof(hdr));
     }
-    else
+
+    // The index must match the current table exactly, if the table
+    // has been appended to since then the index is stale
+    auto entries = mapped.subspan(std::min(mapped.size(), sizeof(IndexHeader)));
+    if (hdr.magic != kIndexMagic ||
+        (hdr.width != sizeof(uint32_t) && hdr.width != sizeof(uint64_t)) ||
+        hdr.count != GetCount() ||
+        entries.size() != hdr.count * hdr.width)
     {
-        if (subspan_data.size() % sizeof(TableRecord) != 0)
-        {
-            std::cerr << "Invalid or currupt table file. Data not a multiple of chain width" << std::endl;
-            return false;
-        }
-        m_MappedTableRecords = cracktools::SpanCast<TableRecord>(subspan_data);
+        std::cerr << "Table index is invalid or out of date" << std::endl;
+        cracktools::UnmapFileSpan(mapped, fp);
+        return false;
     }
 
+    m_MappedIndex = mapped;
+    m_MappedIndexFd = fp;
 
-    return true;
-}
+    if (m_AdviseLookups)
+    {
+        cracktools::MadviseSpan(m_MappedIndex, MADV_RANDOM);
+    }
 
-const TableRecord
-RainbowTable::GetRecordAt(
-    const size_t Index
-) const
-{
-    if (m_TableType == TypeCompressed)
+    if (hdr.width == sizeof(uint32_t))
     {
-        TableRecord entry;
-        entry.startpoint = Index;
-        entry.endpoint = m_MappedTableRecordsCompressed[Index].endpoint;
-        return entry;
+        m_MappedIndex32 = cracktools::SpanCast<const uint32_t>(entries);
     }
     else
     {
-        return m_MappedTableRecords[Index];
+        m_MappedIndex64 = cracktools::SpanCast<const uint64_t>(entries);
     }
+
+    return true;
 }
 
-const uint64_t
-RainbowTable::GetEndpointAt(
-    const size_t Index
+const size_t
+RainbowTable::GetSortMemory(
+    void
 ) const
 {
-    return GetRecordAt(Index).endpoint;
+    if (m_SortMemory != 0)
+    {
+        return m_SortMemory;
+    }
+    // Default to a quarter of physical memory
+    return sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE) / 4;
+}
+
+// Calls Fn with every record of the mapped table. Delta tables
+// come out sorted by endpoint, other types in their stored order
+template <typename RecordFn>
+void
+RainbowTable::ForEachRecord(
+    RecordFn&& Fn
+) const
+{
+    if (m_TableType == TypeDelta)
+    {
+        size_t position = 0;
+        for (size_t block = 0; block < m_DeltaBlocks.size(); block++)
+        {
+            auto reader = GetDeltaBlock(block);
+            do
+            {
+                Fn(TableRecord{ GetSortedChainAt(position), reader.Value() });
+                position++;
+            } while (reader.Next());
+        }
+    }
+    else if (m_TableType == TypeCompressed)
+    {
+        for (size_t i = 0; i < m_MappedTableRecordsCompressed.size(); i++)
+        {
+            Fn(TableRecord{ i, m_MappedTableRecordsCompressed[i].endpoint });
+        }
+    }
+    else
+    {
+        for (const auto& record : m_MappedTableRecords)
+        {
+            Fn(record);
+        }
+    }
+}
+
+// Sorts every record of the mapped table and streams them to Output in
+// batches. Tables larger than the sort memory are sorted in runs on a
+// dispatch pool and spilled next to TempPrefix before being merged
+template <typename Compare, typename OutputFn>
+bool
+RainbowTable::SortRecords(
+    const std::filesystem::path& TempPrefix,
+    Compare Comparator,
+    OutputFn&& Output
+) const
+{
+    const size_t threads = m_Threads != 0 ? m_Threads : std::thread::hardware_concurrency();
+    dispatch::DispatchPoolPtr pool;
+    if (threads > 1)
+    {
+        pool = dispatch::CreateDispatchPool("sort", threads);
+    }
+
+    bool success = true;
+    {
+        ExternalSort<TableRecord, Compare> sorter(TempPrefix, GetSortMemory(), pool, threads, Comparator);
+        ForEachRecord([&](const TableRecord& Record) {
+            success = success && sorter.Push(Record);
+        });
+        success = success && sorter.Merge(Output);
+    }
+
+    if (pool != nullptr)
+    {
+        pool->Stop();
+        pool->Wait();
+    }
+
+    return success;
+}
+
+template <typename T>
+static bool
+WriteIndexEntries(
+    FILE* Handle,
+    std::span<const TableRecord> Records
+)
+{
+    constexpr size_t kWriteBatch = 65536;
+    std::vector<T> batch;
+    batch.reserve(kWriteBatch);
+
+    for (const auto& record : Records)
+    {
+        batch.push_back(static_cast<T>(record.startpoint));
+        if (batch.size() == kWriteBatch)
+        {
+            if (fwrite(batch.data(), sizeof(T), batch.size(), Handle) != batch.size())
+            {
+                return false;
+            }
+            batch.clear();
+        }
+    }
+
+    return fwrite(batch.data(), sizeof(T), batch.size(), Handle) == batch.size();
+}
+
+bool
+RainbowTable::BuildIndex(
+    void
+)
+{
+    if (m_TableType != TypeCompressed)
+    {
+        std::cerr << "Only compressed tables require an index" << std::endl;
+        return false;
+    }
+
+    if (!MapTable(true))
+    {
+        std::cerr << "Error mapping table for indexing" << std::endl;
+        return false;
+    }
+
+    UnmapIndex();
+
+    const size_t count = m_MappedTableRecordsCompressed.size();
+    std::cerr << "Indexing " << count << " chains" << std::endl;
+
+    IndexHeader hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = kIndexMagic;
+    hdr.width = count > std::numeric_limits<uint32_t>::max() ? sizeof(uint64_t) : sizeof(uint32_t);
+    hdr.count = count;
+
+    // Write to a temporary file first so that a partially
+    // written index is never picked up
+    const auto indexPath = GetIndexPath();
+    const auto tempPath = std::filesystem::path(indexPath).concat(".tmp");
+
+    FILE* fh = fopen(tempPath.c_str(), "w");
+    if (fh == nullptr)
+    {
+        std::cerr << "Error opening index for write: " << tempPath << std::endl;
+        return false;
+    }
+
+    // Pair each endpoint with its chain index and sort by endpoint.
+    // Sorting the pairs keeps the sort cache friendly rather than
+    // sorting the indexes and chasing them into the mapping
+    bool success = fwrite(&hdr, sizeof(hdr), 1, fh) == 1;
+    success = success && SortRecords(
+        std::filesystem::path(indexPath).concat(".sort"),
+        EndpointOrder,
+        [&](std::span<const TableRecord> Records) {
+            if (hdr.width == sizeof(uint32_t))
+            {
+                return WriteIndexEntries<uint32_t>(fh, Records);
+            }
+            return WriteIndexEntries<uint64_t>(fh, Records);
+        }
+    );
+    fclose(fh);
+
+    if (!success)
+    {
+        std::cerr << "Error writing table index" << std::endl;
+        std::filesystem::remove(tempPath);
+        return false;
+    }
+
+    std::filesystem::rename(tempPath, indexPath);
+    return true;
+}
+
+const size_t
+RainbowTable::GetIndexedChain(
+    const size_t Position
+) const
+{
+    if (!m_MappedIndex32.empty())
+    {
+        return m_MappedIndex32[Position];
+    }
+    return m_MappedIndex64[Position];
+}
+
+// The table viewed in endpoint order. Uncompressed tables are stored
+// that way, compressed tables are viewed through the index
+const size_t
+RainbowTable::GetSortedCount(
+    void
+) const
+{
+    if (m_TableType == TypeCompressed)
+    {
+        return m_MappedTableRecordsCompressed.size();
+    }
+    else if (m_TableType == TypeDelta)
+    {
+        return m_DeltaHeader.count;
+    }
+    return m_MappedTableRecords.size();
+}
+
+const size_t
+RainbowTable::GetSortedChainAt(
+    const size_t Position
+) const
+{
+    if (m_TableType == TypeCompressed)
+    {
+        return GetIndexedChain(Position);
+    }
+    else if (m_TableType == TypeDelta)
+    {
+        return cracktools::BitPackedGet(m_DeltaStartpoints, m_DeltaHeader.startbits, Position);
+    }
+    return m_MappedTableRecords[Position].startpoint;
+}
+
+const uint64_t
+RainbowTable::GetSortedEndpointAt(
+    const size_t Position
+) const
+{
+    if (m_TableType == TypeCompressed)
+    {
+        return m_MappedTableRecordsCompressed[GetIndexedChain(Position)].endpoint;
+    }
+    else if (m_TableType == TypeDelta)
+    {
+        auto reader = GetDeltaBlock(Position / m_DeltaHeader.blockchains);
+        for (size_t i = 0; i < Position % m_DeltaHeader.blockchains; i++)
+        {
+            reader.Next();
+        }
+        return reader.Value();
+    }
+    return m_MappedTableRecords[Position].endpoint;
+}
+
+cracktools::DeltaBlockReader
+RainbowTable::GetDeltaBlock(
+    const size_t Block
+) const
+{
+    const size_t first = Block * m_DeltaHeader.blockchains;
+    const size_t count = std::min<size_t>(m_DeltaHeader.blockchains, m_DeltaHeader.count - first);
+    const size_t offset = m_DeltaBlocks[Block].offset;
+    const size_t end = Block + 1 < m_DeltaBlocks.size() ? m_DeltaBlocks[Block + 1].offset : m_DeltaData.size();
+    return cracktools::DeltaBlockReader(m_DeltaBlocks[Block].first, m_DeltaData.subspan(offset, end - offset), count);
+}
+
+// Prefetches the entry at the position in the endpoint sorted view,
+// the index entry for compressed tables. How the pages of tables larger
+// than memory are read is advised once when they are mapped
+void
+RainbowTable::PrefetchSortedAt(
+    const size_t Position
+) const
+{
+    if (m_TableType == TypeCompressed && !m_MappedIndex32.empty())
+    {
+        __builtin_prefetch(&m_MappedIndex32[Position]);
+    }
+    else if (m_TableType == TypeCompressed)
+    {
+        __builtin_prefetch(&m_MappedIndex64[Position]);
+    }
+    else
+    {
+        __builtin_prefetch(&m_MappedTableRecords[Position]);
+    }
+}
+
+// Prefetches the record a compressed table's index entry points to.
+// Reading the entry waits only for the prefetch of it already in flight
+void
+RainbowTable::PrefetchIndexedRecordAt(
+    const size_t Position
+) const
+{
+    __builtin_prefetch(&m_MappedTableRecordsCompressed[GetIndexedChain(Position)]);
+}
+
+// Finds the first position of each of the sorted endpoints in the
+// endpoint sorted view of the table, or GetSortedCount() if it is
+// past the end. The endpoints are resolved in a single forward sweep,
+// each group starts searching where the last group finished. Endpoints
+// are reductions of hashes so they are close to uniform over the
+// keyspace, which makes interpolating the next probe from the known
+// bounds converge far quicker than bisecting. Any step where that
+// fails to halve the range is followed by a binary search step. The
+// group is searched in lockstep, every probe of a step is prefetched
+// before any of them are read so that the misses overlap, for
+// compressed tables the index entries and then the records they name
+void
+RainbowTable::LookupEndpoints(
+    std::span<const uint64_t> Endpoints,
+    std::span<size_t> Positions
+) const
+{
+    const size_t count = GetSortedCount();
+    std::array<size_t, kLookupGroup> low;
+    std::array<size_t, kLookupGroup> high;
+    std::array<uint64_t, kLookupGroup> lowKey;
+    std::array<uint64_t, kLookupGroup> highKey;
+    std::array<size_t, kLookupGroup> probe;
+    std::array<bool, kLookupGroup> bisect;
+    size_t base = 0;
+
+    for (size_t group = 0; group < Endpoints.size(); group += kLookupGroup)
+    {
+        const size_t groupSize = std::min(kLookupGroup, Endpoints.size() - group);
+        auto endpoints = Endpoints.subspan(group, groupSize);
+
+        // Everything from the base onwards is at least as
+        // large as the entry just before it in the table
+        const uint64_t baseKey = base == 0 ? m_EndpointMin : GetSortedEndpointAt(base - 1);
+        for (size_t i = 0; i < groupSize; i++)
+        {
+            low[i] = base;
+            high[i] = count;
+            lowKey[i] = baseKey;
+            highKey[i] = m_EndpointMax;
+            bisect[i] = m_EndpointMax <= m_EndpointMin;
+        }
+
+        bool searching = true;
+        while (searching)
+        {
+            for (size_t i = 0; i < groupSize; i++)
+            {
+                if (low[i] < high[i])
+                {
+                    const size_t range = high[i] - low[i];
+                    if (bisect[i] || endpoints[i] < lowKey[i] || highKey[i] <= lowKey[i])
+                    {
+                        probe[i] = low[i] + range / 2;
+                    }
+                    else
+                    {
+                        const unsigned __int128 offset = (unsigned __int128)(endpoints[i] - lowKey[i]) * range / ((unsigned __int128)(highKey[i] - lowKey[i]) + 1);
+                        probe[i] = low[i] + std::min<size_t>(offset, range - 1);
+                    }
+                    PrefetchSortedAt(probe[i]);
+                }
+            }
+
+            // The records of compressed tables are only known once their
+            // index entries arrive, so they are prefetched as a second wave
+            if (m_TableType == TypeCompressed)
+            {
+                for (size_t i = 0; i < groupSize; i++)
+                {
+                    if (low[i] < high[i])
+                    {
+                        PrefetchIndexedRecordAt(probe[i]);
+                    }
+                }
+            }
+
+            searching = false;
+            for (size_t i = 0; i < groupSize; i++)
+            {
+                if (low[i] < high[i])
+                {
+                    const size_t range = high[i] - low[i];
+                    const uint64_t endpoint = GetSortedEndpointAt(probe[i]);
+                    if (endpoint < endpoints[i])
+                    {
+                        low[i] = probe[i] + 1;
+                        lowKey[i] = endpoint;
+                    }
+                    else
+                    {
+                        high[i] = probe[i];
+                        highKey[i] = endpoint;
+                    }
+                    bisect[i] = !bisect[i] && (high[i] - low[i]) > range / 2;
+                    searching |= low[i] < high[i];
+                }
+            }
+        }
+
+        for (size_t i = 0; i < groupSize; i++)
+        {
+            Positions[group + i] = low[i];
+        }
+        base = low[groupSize - 1];
+    }
+}
+
+// Calls Match(i, chain) for every chain in the table which ends in the
+// i'th of the sorted endpoints. Returning false from Match stops the search
+template <typename MatchFn>
+void
+RainbowTable::MatchEndpoints(
+    std::span<const uint64_t> Endpoints,
+    MatchFn&& Match
+) const
+{
+    // Unindexed compressed tables can't be searched, instead make a
+    // single pass over the table looking up each endpoint in the
+    // sorted endpoints, which are small enough to stay in cache
+    if (m_TableType == TypeCompressed && !TableIndexed())
+    {
+        for (size_t chain = 0; chain < m_MappedTableRecordsCompressed.size(); chain++)
+        {
+            auto [begin, end] = std::equal_range(Endpoints.begin(), Endpoints.end(), m_MappedTableRecordsCompressed[chain].endpoint);
+            for (auto it = begin; it != end; it++)
+            {
+                if (!Match(std::distance(Endpoints.begin(), it), chain))
+                {
+                    return;
+                }
+            }
+        }
+    }
+    // Delta tables find the endpoint in the block index and decode forwards
+    // from the block before the first one starting at or after it, as a
+    // run of equal endpoints can carry on across the start of a block
+    else if (m_TableType == TypeDelta)
+    {
+        auto block = m_DeltaBlocks.begin();
+        for (size_t i = 0; i < Endpoints.size(); i++)
+        {
+            const uint64_t endpoint = Endpoints[i];
+            block = std::lower_bound(
+                block, m_DeltaBlocks.end(), endpoint,
+                [](const DeltaBlock& Block, const uint64_t Endpoint) {
+                    return Block.first < Endpoint;
+                }
+            );
+
+            size_t current = std::distance(m_DeltaBlocks.begin(), block);
+            current -= current > 0 ? 1 : 0;
+
+            bool searching = true;
+            for (; current < m_DeltaBlocks.size() && searching; current++)
+            {
+                auto reader = GetDeltaBlock(current);
+                size_t position = current * m_DeltaHeader.blockchains;
+                do
+                {
+                    if (reader.Value() > endpoint)
+                    {
+                        searching = false;
+                        break;
+                    }
+                    if (reader.Value() == endpoint && !Match(i, GetSortedChainAt(position)))
+                    {
+                        return;
+                    }
+                    position++;
+                } while (reader.Next());
+            }
+        }
+    }
+    else
+    {
+        const size_t count = GetSortedCount();
+        std::vector<size_t> positions(Endpoints.size());
+        LookupEndpoints(Endpoints, positions);
+        for (size_t i = 0; i < Endpoints.size(); i++)
+        {
+            for (size_t p = positions[i]; p < count && GetSortedEndpointAt(p) == Endpoints[i]; p++)
+            {
+                if (!Match(i, GetSortedChainAt(p)))
+                {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+bool
+RainbowTable::MapTable(
+    const bool ReadOnly
+)
+{
+    // Check if it is already mapped
+    if (TableMapped())
+    {
+        if (m_MappedReadOnly == ReadOnly)
+        {
+            return true;
+        }
+        // Unmap it to remap writable
+        if (!UnmapTable())
+        {
+            std::cerr << "Unmapping table failed" << std::endl;
+            return false;
+        }
+    }
+
+    // Tables larger than memory can't be read ahead in full, the whole
+    // mapping is advised as random access instead so each probe faults
+    // in only the page it reads
+    const size_t memory = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_PAGESIZE);
+    m_AdviseLookups = std::filesystem::file_size(m_Path) > memory / 2;
+
+    int flags = ReadOnly ? MAP_PRIVATE : MAP_SHARED;
+    int prot = ReadOnly ? PROT_READ : (PROT_READ | PROT_WRITE);
+    auto mapping = cracktools::MmapFileSpan<uint8_t>(m_Path, prot, flags, /*madvise*/ !m_AdviseLookups);
+
+    if (!mapping.has_value())
+    {
+        std::cerr << "Error: unable to map table file " << m_Path.filename() << std::endl;
+        return false;
+    }
+
+    auto [mapped, fp] = mapping.value();
+
+    m_MappedTable = mapped;
+    m_MappedTableFd = fp;
+
+    if (m_AdviseLookups)
+    {
+        cracktools::MadviseSpan(m_MappedTable, MADV_RANDOM);
+    }
+    
+    auto subspan_data = m_MappedTable.subspan(sizeof(TableHeader));
+    if (m_TableType == TypeCompressed)
+    {
+        
+        if (subspan_data.size() % sizeof(TableRecordCompressed) != 0)
+        {
+            std::cerr << "Invalid or currupt table file. Data not a multiple of chain width" << std::endl;
+            return false;
+        }
+        m_MappedTableRecordsCompressed = cracktools::SpanCast<TableRecordCompressed>(subspan_data);
+    }
+    else if (m_TableType == TypeDelta)
+    {
+        // The sizes were validated when the header was loaded
+        auto blocks = subspan_data.subspan(sizeof(DeltaHeader), m_DeltaHeader.blocks * sizeof(DeltaBlock));
+        auto startpoints = subspan_data.subspan(sizeof(DeltaHeader) + blocks.size(), m_DeltaHeader.startwords * sizeof(uint64_t));
+        m_DeltaBlocks = cracktools::SpanCast<const DeltaBlock>(blocks);
+        m_DeltaStartpoints = cracktools::SpanCast<const uint64_t>(startpoints);
+        m_DeltaData = subspan_data.subspan(sizeof(DeltaHeader) + blocks.size() + startpoints.size());
+    }
+    else
+    {
+        if (subspan_data.size() % sizeof(TableRecord) != 0)
+        {
+            std::cerr << "Invalid or currupt table file. Data not a multiple of chain width" << std::endl;
+            return false;
+        }
+        m_MappedTableRecords = cracktools::SpanCast<TableRecord>(subspan_data);
+    }
+
+
+    return true;
+}
+
+const TableRecord
+RainbowTable::GetRecordAt(
+    const size_t Index
+) const
+{
+    if (m_TableType == TypeCompressed)
+    {
+        TableRecord entry;
+        entry.startpoint = Index;
+        entry.endpoint = m_MappedTableRecordsCompressed[Index].endpoint;
+        return entry;
+    }
+    else if (m_TableType == TypeDelta)
+    {
+        TableRecord entry;
+        entry.startpoint = GetSortedChainAt(Index);
+        entry.endpoint = GetSortedEndpointAt(Index);
+        return entry;
+    }
+    else
+    {
+        return m_MappedTableRecords[Index];
+    }
+}
+
+const uint64_t
+RainbowTable::GetEndpointAt(
+    const size_t Index
+) const
+{
+    return GetRecordAt(Index).endpoint;
 }
 
 /* static */
@@ -754,110 +1681,210 @@ RainbowTable::FindStartIndexForEndpoint(
     const uint64_t Endpoint
 ) const
 {
-    // Uncompressed tables are just flat files
-    // of unsorted endpoints so we need to do a Linear search
-    if (m_TableType == TypeCompressed)
-    {
-        // Use std::find to find the endpoint the endpoint in the m_MappedTableRecordsCompressed span
-        auto comparitor = [Endpoint](const TableRecordCompressed& record) {
-            return record.endpoint == Endpoint;
-        };
-        auto it = std::find_if(m_MappedTableRecordsCompressed.begin(), m_MappedTableRecordsCompressed.end(), comparitor);
-        if (it != m_MappedTableRecordsCompressed.end())
-        {
-            return std::distance(m_MappedTableRecordsCompressed.begin(), it);
-        }
-    }
-    // Uncompressed files are flat binary files of TableRecord.
-    // Each record has two uint64_t values, the startpoint and the endpoint.
-    // They are sorted by endpoint.
-    else
+    std::optional<size_t> startpoint;
+    MatchEndpoints(
+        cracktools::UnsafeSpan<const uint64_t>(&Endpoint, 1),
+        [&](const size_t Index, const size_t Chain) {
+            startpoint = Chain;
+            return false;
+        }
+    );
+    return startpoint;
+}
+
+// Walks Count chains through to the end of the table. Start returns the
+// hash and column each walk begins from. The walks are packed into the
+// SIMD lanes and stepped together, when a walk reaches the end of the
+// chain its endpoint is passed to Completed and the lane is refilled
+// with the next walk. Walking stops early if Completed returns false
+template <typename StartFn, typename CompletedFn>
+void
+RainbowTable::WalkChains(
+    const HybridReducer& Reducer,
+    const size_t Count,
+    StartFn&& Start,
+    CompletedFn&& Completed
+) const
+{
+    const size_t lanes = SimdLanes();
+    const size_t hashWidth = m_HashWidth;
+    const size_t finalIteration = m_Length - 1;
+
+    WordGenerator wordGenerator(m_Charset);
+    wordGenerator.GenerateParsingLookupTable();
+
+    SimdHashBufferFixed<kSmallStringMaxLength> words;
+    std::array<uint8_t, MAX_HASH_SIZE * MAX_LANES> hashBuffer;
+    auto hashes = cracktools::UnsafeSpan<uint8_t>(hashBuffer.data(), hashWidth * lanes);
+
+    // The walk held in each lane and its current chain position
+    std::array<size_t, MAX_LANES> walks;
+    std::array<size_t, MAX_LANES> positions;
+    std::array<bool, MAX_LANES> active{};
+    size_t activeLanes = 0;
+    size_t next = 0;
+
+    while (!m_Cracked)
     {
-        // Perform a binary search based on the endpoint and return the startpoint
-        // of a matching record
-        ssize_t low = 0;
-        ssize_t high = m_MappedTableRecords.size() - 1;
-        while (low <= high)
+        for (size_t lane = 0; lane < lanes; lane++)
         {
-            ssize_t mid = low + (high - low) / 2;
-            if (m_MappedTableRecords[mid].endpoint == Endpoint)
-            {
-                return m_MappedTableRecords[mid].startpoint;
-            }
-            else if (m_MappedTableRecords[mid].endpoint < Endpoint)
+            // Retire finished walks and refill the lane until it
+            // holds a walk which still has hashing left to do
+            while (true)
             {
-                low = mid + 1;
+                if (active[lane] && positions[lane] == finalIteration)
+                {
+                    active[lane] = false;
+                    activeLanes--;
+
+                    const uint64_t endpoint = wordGenerator.Parse64Lookup(words.GetStringView(lane));
+                    if (!Completed(walks[lane], endpoint))
+                    {
+                        return;
+                    }
+                }
+
+                if (active[lane] || next == Count)
+                {
+                    break;
+                }
+
+                auto [hash, iteration] = Start(next);
+                const size_t length = Reducer.Reduce(words.GetBufferChar(lane), hash, iteration);
+                words.SetLength(lane, length);
+                walks[lane] = next++;
+                positions[lane] = iteration;
+                active[lane] = true;
+                activeLanes++;
             }
-            else
+        }
+
+        if (activeLanes == 0)
+        {
+            break;
+        }
+
+        // Step every lane one hash/reduce along its chain
+        SimdHashOptimized(
+            m_Algorithm,
+            words.GetLengths(),
+            words.ConstBuffers(),
+            &hashes[0]
+        );
+
+        for (size_t lane = 0; lane < lanes; lane++)
+        {
+            if (active[lane])
             {
-                high = mid - 1;
+                auto hash = hashes.subspan(lane * hashWidth, hashWidth);
+                const size_t length = Reducer.Reduce(words.GetBufferChar(lane), hash, ++positions[lane]);
+                words.SetLength(lane, length);
             }
         }
-        
     }
-    return std::nullopt;
 }
 
-// Checks a chain assuming the given iteration
+// Checks the chains assuming each of the given iterations. The endpoints
+// are looked up in sorted batches rather than one search per walk
 std::optional<std::string>
-RainbowTable::CheckIteration(
+RainbowTable::CheckIterations(
     const HybridReducer& Reducer,
     std::span<const uint8_t> Target,
-    const size_t Iteration
+    std::span<const size_t> Iterations
 ) const
 {
-    std::array<uint8_t, MAX_HASH_SIZE> hashBuffer;
-    auto hash = cracktools::UnsafeSpan<uint8_t>(hashBuffer.data(), m_HashWidth);
-    std::array<char, 31> reduced;
-    size_t length;
+    std::optional<std::string> result;
+    std::vector<uint64_t> pending;
+    pending.reserve(kLookupBatch);
+
+    // Checks every chain which ends in one of the pending endpoints,
+    // if it matches, we can perform one full chain to see if we find it
+    auto resolve = [&]() {
+        std::sort(pending.begin(), pending.end());
+        pending.erase(std::unique(pending.begin(), pending.end()), pending.end());
+
+        MatchEndpoints(
+            pending,
+            [&](const size_t Index, const size_t Chain) {
+                result = ValidateChain(Chain, &Target[0]);
+                return !result.has_value();
+            }
+        );
 
-    cracktools::SpanCopy(hash, Target);
+        pending.clear();
+        return !result.has_value();
+    };
+
+    WalkChains(
+        Reducer,
+        Iterations.size(),
+        [&](const size_t Walk) {
+            return std::make_tuple(Target, Iterations[Walk]);
+        },
+        [&](const size_t Walk, const uint64_t Endpoint) {
+            pending.push_back(Endpoint);
+            return pending.size() < kLookupBatch || resolve();
+        }
+    );
 
-    for (size_t j = Iteration; j < m_Length - 1; j++)
+    if (!result.has_value() && !pending.empty() && !m_Cracked)
     {
-        length = Reducer.Reduce(reduced, hash, j);
-        DoHash((uint8_t*)&reduced[0], length, &hash[0]);
+        resolve();
     }
 
-    // Final reduction
-    length = Reducer.Reduce(reduced, hash, m_Length - 1);
-
-    // Convert the endpoint to a uint64_t
-    const std::string_view endpointString(&reduced[0], length);
-    const uint64_t endpoint = WordGenerator::Parse64(endpointString, m_Charset);
-
-    // Check end, if it matches, we can perform one full chain to see if we find it
-    auto index = FindStartIndexForEndpoint(endpoint);
-    if (index.has_value())
-    {
-        return ValidateChain(index.value(), &Target[0]);
-    }
-    return std::nullopt;
+    return result;
 }
 
 void
 RainbowTable::CrackOneWorker(
     const size_t ThreadId,
-    const std::vector<uint8_t> Target
+    std::span<const uint8_t> Target
 )
 {
     HybridReducer reducer(m_Min, m_Max, m_Charset);
 
-    m_CrackingThreadsRunning++;
+    // Each thread takes every m_Threads'th iteration so the
+    // work is spread evenly between short and long walks
+    std::vector<size_t> iterations;
+    for (ssize_t i = m_Length - 1 - ThreadId; i >= 0; i -= m_Threads)
+    {
+        iterations.push_back(i);
+    }
+
+    auto result = CheckIterations(reducer, Target, iterations);
+    bool cracked = m_Cracked;
+    if (result.has_value() && !cracked && m_Cracked.compare_exchange_strong(cracked, true))
+    {
+        m_Cracked = true;
+        m_LastCracked = std::make_tuple(Util::ToHex(&Target[0], Target.size()), result.value());
+        m_CrackedResults.push_back(m_LastCracked);
+    }
+}
 
-    for (ssize_t i = m_Length - 1 - ThreadId; i >= 0 && !m_Cracked; i -= m_Threads)
+// Runs the task once on each worker thread and waits for them all
+// to finish. Single threaded runs it on the calling thread
+void
+RainbowTable::RunOnWorkers(
+    const std::function<void(const size_t)>& Task
+)
+{
+    if (m_Threads == 1)
     {
-        auto result = CheckIteration(reducer, Target, i);
-        bool cracked = m_Cracked;
-        if (result.has_value() && !cracked && m_Cracked.compare_exchange_strong(cracked, true))
-        {
-            m_Cracked = true;
-            m_LastCracked = std::make_tuple(Util::ToHex(&Target[0], Target.size()), result.value());
-            m_CrackedResults.push_back(m_LastCracked);
-        }
+        Task(0);
+        return;
     }
 
-    m_CrackingThreadsRunning--;
+    std::latch done(m_Threads);
+    for (size_t i = 0; i < m_Threads; i++)
+    {
+        m_DispatchPool->PostTask(
+            [&Task, &done, i]() {
+                Task(i);
+                done.count_down();
+            }
+        );
+    }
+    done.wait();
 }
 
 std::optional<std::string>
@@ -879,52 +1906,200 @@ RainbowTable::CrackOne(
     // Perform linear check
     if (m_Threads == 1)
     {
-        for (ssize_t i = m_Length - 1; i >= 0; i--)
+        std::vector<size_t> iterations(m_Length);
+        for (size_t i = 0; i < m_Length; i++)
         {
-            result = CheckIteration(reducer, target, i);
-            if (result.has_value())
-            {
-                break;
-            }
+            iterations[i] = m_Length - 1 - i;
         }
+        result = CheckIterations(reducer, target, iterations);
     }
     else
     {
         m_ThreadsCompleted = m_Threads;
 
-        // Dispatch the work to the worker threads
-        for (size_t i = 0; i < m_Threads; i++)
+        RunOnWorkers(
+            [this, &target](const size_t ThreadId) {
+                CrackOneWorker(ThreadId, target);
+            }
+        );
+
+        // Check if we found the result
+        if (m_Cracked)
         {
-            m_DispatchPool->PostTask(
-                dispatch::bind(
-                    &RainbowTable::CrackOneWorker,
-                    this,
-                    i,
-                    target
-                )
-            );
+            result = std::get<1>(m_LastCracked);
+        }
+    }
+
+    return result;
+}
+
+// Walks every column of this thread's share of the batch targets and
+// records the endpoints. Each thread owns a contiguous run of targets
+// and sorts its own candidates so the runs only need merging
+void
+RainbowTable::GenerateCandidates(
+    const size_t ThreadId,
+    std::span<const uint8_t> Targets,
+    std::span<CrackCandidate> Candidates
+) const
+{
+    HybridReducer reducer(m_Min, m_Max, m_Charset);
+
+    const size_t targetCount = Targets.size() / m_HashWidth;
+    const size_t first = targetCount * ThreadId / m_Threads;
+    const size_t last = targetCount * (ThreadId + 1) / m_Threads;
+    auto candidates = Candidates.subspan(first * m_Length, (last - first) * m_Length);
+
+    WalkChains(
+        reducer,
+        candidates.size(),
+        [&](const size_t Walk) {
+            const size_t target = first + Walk / m_Length;
+            return std::make_tuple(Targets.subspan(target * m_HashWidth, m_HashWidth), Walk % m_Length);
+        },
+        [&](const size_t Walk, const uint64_t Endpoint) {
+            candidates[Walk].endpoint = Endpoint;
+            candidates[Walk].target = first + Walk / m_Length;
+            return true;
         }
+    );
+
+    std::sort(candidates.begin(), candidates.end());
+}
+
+// Resolves the sorted candidates against the table and returns a
+// (chain, target) pair for every table chain with a matching endpoint
+std::vector<std::tuple<size_t, size_t>>
+RainbowTable::JoinCandidates(
+    std::span<const CrackCandidate> Candidates
+) const
+{
+    std::vector<std::tuple<size_t, size_t>> hits;
 
-        // Wait for at least one thread to start
-        while (m_CrackingThreadsRunning == 0)
+    // The candidates are sorted by endpoint so the table only
+    // needs searching once for each distinct endpoint
+    std::vector<uint64_t> endpoints;
+    std::vector<size_t> firsts;
+    for (size_t i = 0; i < Candidates.size(); i++)
+    {
+        if (i == 0 || Candidates[i].endpoint != Candidates[i - 1].endpoint)
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            endpoints.push_back(Candidates[i].endpoint);
+            firsts.push_back(i);
+        }
+    }
+    firsts.push_back(Candidates.size());
+
+    // All candidates with an endpoint match every chain with it
+    MatchEndpoints(
+        endpoints,
+        [&](const size_t Index, const size_t Chain) {
+            for (size_t c = firsts[Index]; c < firsts[Index + 1]; c++)
+            {
+                hits.emplace_back(Chain, Candidates[c].target);
+            }
+            return true;
         }
+    );
+
+    return hits;
+}
+
+// Validates this thread's share of the hits, which are sorted by target
+// so that each target belongs to exactly one thread
+void
+RainbowTable::ValidateCandidates(
+    const size_t ThreadId,
+    std::span<const uint8_t> Targets,
+    std::span<const std::tuple<size_t, size_t>> Hits,
+    std::vector<std::optional<std::string>>& Results
+) const
+{
+    const size_t targetCount = Targets.size() / m_HashWidth;
+    const size_t first = targetCount * ThreadId / m_Threads;
+    const size_t last = targetCount * (ThreadId + 1) / m_Threads;
+
+    auto byTarget = [](const std::tuple<size_t, size_t>& Hit, const size_t Target) {
+        return std::get<1>(Hit) < Target;
+    };
+    auto it = std::lower_bound(Hits.begin(), Hits.end(), first, byTarget);
+    auto end = std::lower_bound(it, Hits.end(), last, byTarget);
 
-        // Wait for the threads to finish
-        while (m_CrackingThreadsRunning != 0)
+    for (; it != end; it++)
+    {
+        auto [chain, target] = *it;
+        if (Results[target].has_value())
         {
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
         }
+        Results[target] = ValidateChain(chain, &Targets[target * m_HashWidth]);
+    }
+}
 
-        // Check if we found the result
-        if (m_Cracked)
+// Cracks a batch of hashes together. The chain walks for every target
+// and column are done up front, then the endpoints are sorted and joined
+// against the table in one pass before validating the matching chains
+std::vector<std::optional<std::string>>
+RainbowTable::CrackBatch(
+    std::span<const std::string> Hashes
+)
+{
+    std::vector<uint8_t> targets(Hashes.size() * m_HashWidth);
+    for (size_t i = 0; i < Hashes.size(); i++)
+    {
+        auto target = Util::ParseHex(Hashes[i]);
+        cracktools::SpanCopy<uint8_t>(std::span(targets).subspan(i * m_HashWidth, m_HashWidth), target);
+    }
+
+    m_Cracked = false;
+
+    // Generate the candidate endpoints. Each thread
+    // leaves behind a sorted run of candidates
+    std::vector<CrackCandidate> candidates(Hashes.size() * m_Length);
+    RunOnWorkers(
+        [this, &targets, &candidates](const size_t ThreadId) {
+            GenerateCandidates(ThreadId, targets, candidates);
+        }
+    );
+
+    for (size_t i = 1; i < m_Threads; i++)
+    {
+        const size_t middle = Hashes.size() * i / m_Threads * m_Length;
+        const size_t last = Hashes.size() * (i + 1) / m_Threads * m_Length;
+        std::inplace_merge(candidates.begin(), candidates.begin() + middle, candidates.begin() + last);
+    }
+
+    // Different columns of the same target often reduce to the same
+    // endpoint, they only need looking up and validating once
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    auto hits = JoinCandidates(candidates);
+    candidates.clear();
+    candidates.shrink_to_fit();
+
+    std::sort(
+        hits.begin(), hits.end(),
+        [](const std::tuple<size_t, size_t>& A, const std::tuple<size_t, size_t>& B) {
+            return std::get<1>(A) < std::get<1>(B);
+        }
+    );
+
+    std::vector<std::optional<std::string>> results(Hashes.size());
+    RunOnWorkers(
+        [this, &targets, &hits, &results](const size_t ThreadId) {
+            ValidateCandidates(ThreadId, targets, hits, results);
+        }
+    );
+
+    for (size_t i = 0; i < Hashes.size(); i++)
+    {
+        if (results[i].has_value())
         {
-            result = std::get<1>(m_LastCracked);
+            m_CrackedResults.emplace_back(Util::ToHex(&targets[i * m_HashWidth], m_HashWidth), results[i].value());
         }
     }
 
-    return result;
+    return results;
 }
 
 std::vector<std::tuple<std::string, std::string>>
@@ -946,6 +2121,15 @@ RainbowTable::Crack(
         return {};
     }
 
+    // Compressed tables need the endpoint index for fast lookups
+    if (m_TableType == TypeCompressed && !MapIndex())
+    {
+        if (!m_UseIndex || !BuildIndex() || !MapIndex())
+        {
+            std::cerr << "Warning: compressed table has no index, falling back to linear search" << std::endl;
+        }
+    }
+
     m_Operation = "Cracking";
 
     if (m_Threads == 0)
@@ -974,15 +2158,41 @@ RainbowTable::Crack(
         // Open the input file handle
         m_HashFileStream = std::ifstream(Target);
 
+        // Bound the number of candidates held in memory at once
+        size_t batchSize = m_BatchSize;
+        if (batchSize == 0)
+        {
+            batchSize = std::max<size_t>(kBatchCandidates / m_Length, 1);
+        }
+
+        std::vector<std::string> batch;
         std::string line;
-        while (std::getline(m_HashFileStream, line))
+        bool more = true;
+        while (more)
         {
-            m_ThreadsCompleted = 0;
-            m_Cracked = false;
-            auto result = CrackOne(line);
-            if (result.has_value())
+            more = (bool)std::getline(m_HashFileStream, line);
+            if (more)
+            {
+                if (line.size() != m_HashWidth * 2 || !Util::IsHex(line))
+                {
+                    std::cerr << "Invalid length of provided hash: " << line.size() << " != " << m_HashWidth * 2 << std::endl;
+                    std::cerr << "Hash: '" << line << "'" << std::endl;
+                    continue;
+                }
+                batch.push_back(line);
+            }
+
+            if (batch.size() == batchSize || (!more && !batch.empty()))
             {
-                std::cout << line << m_Separator << result.value() << std::endl;
+                auto results = CrackBatch(batch);
+                for (size_t i = 0; i < batch.size(); i++)
+                {
+                    if (results[i].has_value())
+                    {
+                        std::cout << batch[i] << m_Separator << results[i].value() << std::endl;
+                    }
+                }
+                batch.clear();
             }
         }
     }
@@ -1058,11 +2268,17 @@ RainbowTable::Reset(
     m_HashWidth = 0;
     m_Chains = 0;
     m_TableType = TypeCompressed;
+    m_UseIndex = true;
+    m_BatchSize = 0;
     // For building
     m_StartingChains = 0;
     m_WriteHandle = nullptr;
-    m_NextWriteBlock = 0;
-    m_WriteCache.clear();
+    m_JournalHandle = nullptr;
+    m_JournalBlocks.clear();
+    m_NextBlock = 0;
+    m_WriteFailed = false;
+    m_FreeBlocks.clear();
+    m_BlocksInFlight = 0;
     if (m_DispatchPool != nullptr)
     {
         m_DispatchPool->Stop();
@@ -1077,28 +2293,242 @@ RainbowTable::SortTable(
     void
 )
 {
-    if (!MapTable(false))
+    if (m_TableType != TypeUncompressed)
+    {
+        std::cerr << "Cannot sort compressed tables" << std::endl;
+        return;
+    }
+
+    if (!MapTable(true))
     {
         std::cerr << "Error mapping table for sort"  << std::endl;
         return;
     }
 
-    if (m_TableType == TypeUncompressed)
+    FILE* handle = fopen(m_Path.c_str(), "r+");
+    if (handle == nullptr)
+    {
+        std::cerr << "Error opening table for sort" << std::endl;
+        return;
+    }
+    fseek(handle, sizeof(TableHeader), SEEK_SET);
+
+    // Every record has been read into the sort before the merge
+    // starts so the sorted records can be written back in place
+    const bool success = SortRecords(
+        std::filesystem::path(m_Path).concat(".sort"),
+        EndpointOrder,
+        [handle](std::span<const TableRecord> Records) {
+            return fwrite(Records.data(), sizeof(TableRecord), Records.size(), handle) == Records.size();
+        }
+    );
+    fclose(handle);
+
+    if (!success)
+    {
+        std::cerr << "Error sorting table" << std::endl;
+    }
+}
+
+// Streams records sorted by endpoint into the body of a delta table.
+// The block index, startpoints and deltas each have their own region
+// of the file and are written out as they fill, so nothing is held
+// for the whole table. The regions are sized for Count records and
+// are moved up to close the gaps if fewer are written
+class DeltaTableWriter
+{
+    static constexpr size_t kFlushBytes = 1024 * 1024;
+public:
+    DeltaTableWriter(
+        FILE* Handle,
+        const size_t Count,
+        const uint64_t MaxStartpoint
+    ) : m_Startpoints(cracktools::BitsRequired(MaxStartpoint))
+    {
+        fflush(Handle);
+        m_Fd = fileno(Handle);
+        m_Base = ftell(Handle);
+
+        memset(&m_Header, 0, sizeof(m_Header));
+        m_Header.count = Count;
+        m_Header.blockchains = kDeltaBlockChains;
+        m_Header.blocks = (Count + kDeltaBlockChains - 1) / kDeltaBlockChains;
+        m_Header.startbits = m_Startpoints.GetBits();
+        m_Header.startwords = cracktools::BitPackedWords(Count, m_Header.startbits);
+
+        m_BlockOffset = m_Base + sizeof(DeltaHeader);
+        m_StartOffset = m_BlockOffset + m_Header.blocks * sizeof(DeltaBlock);
+        m_DataOffset = m_StartOffset + m_Header.startwords * sizeof(uint64_t);
+        m_StartBase = m_StartOffset;
+        m_DataBase = m_DataOffset;
+    }
+    bool Push(
+        std::span<const TableRecord> Records
+    )
+    {
+        for (const auto& record : Records)
+        {
+            if (m_Written == m_Header.count)
+            {
+                return false;
+            }
+            if (m_Written % kDeltaBlockChains == 0)
+            {
+                m_Blocks.push_back({ record.endpoint, m_Header.databytes + m_Data.size() });
+            }
+            else
+            {
+                cracktools::VarintAppend(record.endpoint - m_Last, m_Data);
+            }
+            m_Startpoints.Push(record.startpoint);
+            m_Last = record.endpoint;
+            m_Written++;
+
+            // Startpoints can only be flushed on a word boundary,
+            // which every 64 records is guaranteed to be
+            if (m_Written % 64 == 0 && m_Startpoints.GetWords().size_bytes() >= kFlushBytes && !Flush())
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    bool Finish(void)
+    {
+        if (!Flush())
+        {
+            return false;
+        }
+        if (m_Written < m_Header.count && !Compact())
+        {
+            return false;
+        }
+        return pwrite(m_Fd, &m_Header, sizeof(m_Header), m_Base) == sizeof(m_Header);
+    }
+private:
+    bool Write(
+        std::span<const uint8_t> Data,
+        size_t& Offset
+    )
+    {
+        if (pwrite(m_Fd, Data.data(), Data.size(), Offset) != (ssize_t)Data.size())
+        {
+            return false;
+        }
+        Offset += Data.size();
+        return true;
+    }
+    // Copies Length bytes to an earlier offset in the file
+    bool Move(
+        size_t From,
+        size_t To,
+        size_t Length
+    )
+    {
+        std::vector<uint8_t> buffer(std::min(Length, kFlushBytes));
+        while (Length > 0)
+        {
+            const size_t chunk = std::min(Length, buffer.size());
+            if (pread(m_Fd, buffer.data(), chunk, From) != (ssize_t)chunk ||
+                pwrite(m_Fd, buffer.data(), chunk, To) != (ssize_t)chunk)
+            {
+                return false;
+            }
+            From += chunk;
+            To += chunk;
+            Length -= chunk;
+        }
+        return true;
+    }
+    bool Compact(void)
+    {
+        m_Header.count = m_Written;
+        m_Header.blocks = (m_Written + kDeltaBlockChains - 1) / kDeltaBlockChains;
+        m_Header.startwords = cracktools::BitPackedWords(m_Written, m_Header.startbits);
+
+        const size_t startOffset = m_Base + sizeof(DeltaHeader) + m_Header.blocks * sizeof(DeltaBlock);
+        const size_t dataOffset = startOffset + m_Header.startwords * sizeof(uint64_t);
+        return Move(m_StartBase, startOffset, m_Header.startwords * sizeof(uint64_t)) &&
+            Move(m_DataBase, dataOffset, m_Header.databytes) &&
+            ftruncate(m_Fd, dataOffset + m_Header.databytes) == 0;
+    }
+    bool Flush(void)
+    {
+        const bool success =
+            Write(cracktools::AsBytes(std::span<const DeltaBlock>(m_Blocks)), m_BlockOffset) &&
+            Write(cracktools::AsBytes(m_Startpoints.GetWords()), m_StartOffset) &&
+            Write(m_Data, m_DataOffset);
+        m_Header.databytes += m_Data.size();
+        m_Blocks.clear();
+        m_Data.clear();
+        m_Startpoints = cracktools::BitPackedWriter(m_Header.startbits);
+        return success;
+    }
+
+    int m_Fd;
+    size_t m_Base;
+    DeltaHeader m_Header;
+    size_t m_BlockOffset;
+    size_t m_StartOffset;
+    size_t m_DataOffset;
+    size_t m_StartBase;
+    size_t m_DataBase;
+    size_t m_Written = 0;
+    uint64_t m_Last = 0;
+    std::vector<DeltaBlock> m_Blocks;
+    std::vector<uint8_t> m_Data;
+    cracktools::BitPackedWriter m_Startpoints;
+};
+
+bool
+RainbowTable::WriteSortedBuild(
+    void
+)
+{
+    const size_t count = m_BuildSort->GetCount();
+    std::cerr << std::endl << "Merging " << count << " sorted chains" << std::endl;
+
+    if (m_DispatchPool != nullptr)
+    {
+        m_BuildSort->SetPool(m_DispatchPool, m_Threads);
+    }
+
+    bool success;
+    if (m_TableType == TypeDelta)
     {
-        // Sort uncompressed tables by endpoint
-        std::sort(m_MappedTableRecords.begin(), m_MappedTableRecords.end(),
-                    [](const TableRecord& a, const TableRecord& b) {
-                        return a.endpoint < b.endpoint;
+        // Fresh builds number their chains from zero
+        DeltaTableWriter writer(m_WriteHandle, count, count == 0 ? 0 : count - 1);
+        success = m_BuildSort->Merge([&writer](std::span<const TableRecord> Records) {
+            return writer.Push(Records);
         });
+        success = success && writer.Finish();
     }
     else
     {
-        std::cerr << "Cannot sort compressed tables" << std::endl;
-        return;
+        success = m_BuildSort->Merge([this](std::span<const TableRecord> Records) {
+            return fwrite(Records.data(), sizeof(TableRecord), Records.size(), m_WriteHandle) == Records.size();
+        });
+    }
+
+    if (success && m_Perfect)
+    {
+        const size_t dropped = m_BuildSort->GetDropped();
+        std::cerr << "Removed " << dropped << " merged chains (" << std::fixed << std::setprecision(1)
+                  << (count == 0 ? 0.f : 100.f * dropped / count) << "%)" << std::endl;
     }
+
+    m_BuildSort.reset();
+    if (m_SortPool != nullptr)
+    {
+        m_SortPool->Stop();
+        m_SortPool->Wait();
+        m_SortPool = nullptr;
+    }
+
+    return success;
 }
 
-void
+bool
 RainbowTable::ChangeType(
     const std::filesystem::path& Destination,
     const TableType DestinationType
@@ -1107,7 +2537,7 @@ RainbowTable::ChangeType(
     if (m_TableType == DestinationType)
     {
         std::cerr << "Won't convert to same type" << std::endl;
-        return;
+        return false;
     }
 
     // Output some basic information about the current table
@@ -1118,7 +2548,7 @@ RainbowTable::ChangeType(
     if (!MapTable(true))
     {
         std::cerr << "Error mapping table"  << std::endl;
-        return;
+        return false;
     }
 
     TableHeader hdr;
@@ -1135,64 +2565,112 @@ RainbowTable::ChangeType(
     if (fhw == nullptr)
     {
         std::cerr << "Error opening desination table for write: " << Destination << std::endl;
-        return;
+        return false;
     }
 
     // Write the header
     fwrite(&hdr, sizeof(hdr), 1, fhw);
 
+    // The records are sorted into the order of the destination
+    // table and streamed straight into it
+    const auto tempPrefix = std::filesystem::path(Destination).concat(".sort");
+    bool success;
+
     if (DestinationType == TypeCompressed)
     {
-        // Copy the existing table rows to a new vector then sort by start point
-        std::vector<TableRecord> compressedTable(GetCount());
-        std::copy(m_MappedTableRecords.begin(), m_MappedTableRecords.end(), compressedTable.begin());
-        std::sort(compressedTable.begin(), compressedTable.end(),
-                    [](const TableRecord& a, const TableRecord& b) {
-                        return a.startpoint < b.startpoint;
+        // Compressed tables are stored in start point order
+        auto startpointLess = [](const TableRecord& a, const TableRecord& b) {
+            return a.startpoint < b.startpoint;
+        };
+        // Only the endpoints are kept and the chain index is used as the
+        // startpoint, so every startpoint must match its index. Perfect
+        // tables have dropped chains and can't be compressed
+        uint64_t nextStartpoint = 0;
+        bool contiguous = true;
+        std::vector<TableRecordCompressed> compressed;
+        success = SortRecords(tempPrefix, startpointLess, [&](std::span<const TableRecord> Records) {
+            compressed.resize(Records.size());
+            for (size_t i = 0; i < Records.size(); i++)
+            {
+                if (Records[i].startpoint != nextStartpoint++)
+                {
+                    contiguous = false;
+                    return false;
+                }
+                compressed[i] = Records[i];
+            }
+            return fwrite(compressed.data(), sizeof(TableRecordCompressed), compressed.size(), fhw) == compressed.size();
         });
-        TableRecordCompressed compressedRecord;
-        for (const auto& record : compressedTable)
+
+        if (!contiguous)
         {
-            compressedRecord = record;
-            fwrite(&compressedRecord, sizeof(TableRecordCompressed), 1, fhw);
+            fclose(fhw);
+            std::filesystem::remove(Destination);
+            std::cerr << "Table startpoints are not contiguous, perfect tables can't be compressed" << std::endl;
+            return false;
         }
-        fclose(fhw);
     }
-    else
+    else if (DestinationType == TypeDelta)
     {
-        for (size_t i = 0; i < GetCount(); i++)
+        // Compressed tables use the chain index as the startpoint
+        uint64_t maxStartpoint = GetCount() == 0 ? 0 : GetCount() - 1;
+        if (m_TableType == TypeUncompressed)
         {
-            // Read the compressed record
-            TableRecord record;
-            record.startpoint = i;
-            record.endpoint = m_MappedTableRecordsCompressed[i].endpoint;
-            fwrite(&record, sizeof(TableRecord), 1, fhw);
+            maxStartpoint = 0;
+            for (const auto& record : m_MappedTableRecords)
+            {
+                maxStartpoint = std::max(maxStartpoint, record.startpoint);
+            }
         }
-        fclose(fhw);
+
+        // Delta tables are encoded in endpoint order
+        DeltaTableWriter writer(fhw, GetCount(), maxStartpoint);
+        success = SortRecords(tempPrefix, EndpointOrder, [&writer](std::span<const TableRecord> Records) {
+            return writer.Push(Records);
+        });
+        success = success && writer.Finish();
+    }
+    else
+    {
+        std::cout << "Sorting " << GetCount() << " chains" << std::endl;
+
+        success = SortRecords(tempPrefix, EndpointOrder, [fhw](std::span<const TableRecord> Records) {
+            return fwrite(Records.data(), sizeof(TableRecord), Records.size(), fhw) == Records.size();
+        });
+    }
+    fclose(fhw);
+
+    if (!success)
+    {
+        std::filesystem::remove(Destination);
+        std::cerr << "Error writing table " << Destination << std::endl;
+        return false;
     }
 
-    // Perform sort and cleanup work on the new table
+    // Perform cleanup work on the new table
     RainbowTable newtable;
     newtable.SetPath(Destination);
 
     if (!newtable.ValidTable())
     {
         std::cerr << "Decompressed table does not seem valid" << std::endl;
-        return;
+        return false;
     }
 
     if (!newtable.LoadTable())
     {
         std::cerr << "Error loading new table" << std::endl;
-        return;
+        return false;
     }
 
-    std::cout << "Sorting " << newtable.GetCount() << " chains" << std::endl;
-
-    if (m_TableType == TypeCompressed)
+    if (DestinationType == TypeCompressed && m_UseIndex)
     {
-        newtable.SortTable();
+        newtable.SetThreads(m_Threads);
+        newtable.SetSortMemory(m_SortMemory);
+        return newtable.BuildIndex();
     }
+
+    return true;
 }
 
 /* static */ const Chain
@@ -10,12 +10,18 @@
 #define RainbowTable_hpp
 
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <filesystem>
+#include <functional>
 #include <fstream>
 #include <limits>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <set>
+#include <span>
 #include <string>
 #include <tuple>
 
@@ -23,6 +29,8 @@
 #include "simdhash.h"
 
 #include "Chain.hpp"
+#include "DeltaEncoding.hpp"
+#include "ExternalSort.hpp"
 #include "HashList.hpp"
 #include "Reduce.hpp"
 #include "SmallString.hpp"
@@ -31,6 +39,7 @@ typedef enum _TableType
 {
     TypeUncompressed,
     TypeCompressed,
+    TypeDelta,
     TypeInvalid
 } TableType;
 
@@ -58,6 +67,8 @@ typedef struct _TableRecord
     uint64_t endpoint;
 } TableRecord;
 
+typedef bool (*TableRecordCompare)(const TableRecord&, const TableRecord&);
+
 typedef struct _TableRecordCompressed
 {
     bool operator<(const _TableRecordCompressed& other) const
@@ -72,12 +83,89 @@ typedef struct _TableRecordCompressed
     uint64_t endpoint;
 } TableRecordCompressed;
 
+// Compressed tables are stored in startpoint order so they cannot
+// be binary searched. The index is a sidecar file next to the table
+// which holds the chain indexes of the table sorted by endpoint.
+constexpr uint32_t kIndexMagic = 'rti ';
+
+typedef struct __attribute__((__packed__)) _IndexHeader
+{
+    uint32_t magic;
+    uint32_t width;
+    uint64_t count;
+} IndexHeader;
+
+// Builds write blocks straight to their place in the table as they
+// complete, in any order. Each block written is recorded in a journal
+// next to the table so an interrupted build can resume without
+// generating them again. The first entry covers the chains already in
+// the table when the journal was created
+typedef struct _JournalEntry
+{
+    uint64_t start;
+    uint64_t count;
+} JournalEntry;
+
+// Workers may have this many blocks per thread generated but not
+// yet written before they wait for the writer to catch up
+constexpr size_t kBlocksInFlight = 2;
+
+// Delta tables hold the chains sorted by endpoint in blocks of
+// kDeltaBlockChains. The block index holds the first endpoint of each
+// block and the offset of its varint deltas for the rest, the
+// startpoints are bit packed in endpoint order. Layout after the
+// table header: DeltaHeader, DeltaBlock[blocks],
+// uint64_t startpoints[startwords], uint8_t data[databytes]
+constexpr uint32_t kDeltaBlockChains = 256;
+
+typedef struct __attribute__((__packed__)) _DeltaHeader
+{
+    uint64_t count;
+    uint64_t blocks;
+    uint64_t startwords;
+    uint64_t databytes;
+    uint32_t blockchains;
+    uint8_t  startbits;
+    uint8_t  reserved[3];
+} DeltaHeader;
+
+typedef struct _DeltaBlock
+{
+    uint64_t first;
+    uint64_t offset;
+} DeltaBlock;
+
+// An endpoint reached by walking a target hash from one of the
+// columns of the table. Used when cracking hashes in batches
+typedef struct _CrackCandidate
+{
+    bool operator<(const _CrackCandidate& other) const
+    {
+        return endpoint < other.endpoint || (endpoint == other.endpoint && target < other.target);
+    }
+    bool operator==(const _CrackCandidate& other) const
+    {
+        return endpoint == other.endpoint && target == other.target;
+    }
+    uint64_t endpoint;
+    size_t target;
+} CrackCandidate;
+
+// The default number of candidates generated per batch when
+// cracking hash files, bounding the memory used to 64MB
+constexpr size_t kBatchCandidates = 4 * 1024 * 1024;
+
+// Endpoints are looked up in sorted batches of kLookupBatch, which are
+// searched in lockstep groups of kLookupGroup to overlap table misses
+constexpr size_t kLookupBatch = 64;
+constexpr size_t kLookupGroup = 16;
+
 class RainbowTable
 {
 public:
     ~RainbowTable(void);
     void Reset(void);
-    void InitAndRunBuild(void);
+    bool InitAndRunBuild(void);
     bool ValidateConfig(void);
     void SetPath(std::filesystem::path Path) { m_Path = Path; }
     std::filesystem::path GetPath(void) const { return m_Path; }
@@ -99,10 +187,25 @@ public:
     void SetCharset(const std::string Charset) { m_Charset = ParseCharset(Charset); }
     const std::string& GetCharset(void) const { return m_Charset; }
     void SetType(const TableType Type) { m_TableType = Type; }
+    const TableType GetTableType(void) const { return m_TableType; }
     bool SetType(const std::string Type);
     void SetSeparator(const char Separator) { m_Separator = Separator; }
     const char GetSeparator(void) const { return m_Separator; }
-    std::string GetType(void) const { return m_TableType == TypeCompressed ? "Compressed" : "Uncompressed";  }
+    void SetUseIndex(const bool UseIndex) { m_UseIndex = UseIndex; }
+    const bool GetUseIndex(void) const { return m_UseIndex; }
+    std::filesystem::path GetIndexPath(void) const { return std::filesystem::path(m_Path).concat(".idx"); }
+    std::filesystem::path GetJournalPath(void) const { return std::filesystem::path(m_Path).concat(".journal"); }
+    void SetBatchSize(const size_t BatchSize) { m_BatchSize = BatchSize; }
+    void SetSortMemory(const size_t SortMemory) { m_SortMemory = SortMemory; }
+    const size_t GetSortMemory(void) const;
+    const size_t GetBatchSize(void) const { return m_BatchSize; }
+    void SetSortedBuild(const bool SortedBuild) { m_SortedBuild = SortedBuild; }
+    const bool GetSortedBuild(void) const { return m_SortedBuild; }
+    void SetPerfect(const bool Perfect) { m_Perfect = Perfect; }
+    const bool GetPerfect(void) const { return m_Perfect; }
+    bool IndexExists(void) const { return std::filesystem::exists(GetIndexPath()); }
+    bool BuildIndex(void);
+    std::string GetType(void) const;
     float GetCoverage(void);
     bool TableExists(void) const { return std::filesystem::exists(m_Path); }
     static bool GetTableHeader(const std::filesystem::path& Path, TableHeader* Header);
@@ -118,8 +221,9 @@ public:
     static const std::string DoHashHex(const uint8_t* Data, const size_t Length, const HashAlgorithm Algorithm);
     void DoHash(const uint8_t* Data, const size_t Length, uint8_t* Digest) const { DoHash(Data, Length, Digest, m_Algorithm); }
     std::string DoHashHex(const uint8_t* Data, const size_t Length) const { return DoHashHex(Data, Length, m_Algorithm); }
-    void Decompress(const std::filesystem::path& Destination) { ChangeType(Destination, TypeUncompressed); }
-    void Compress(const std::filesystem::path& Destination) { ChangeType(Destination, TypeCompressed); }
+    bool Decompress(const std::filesystem::path& Destination) { return ChangeType(Destination, TypeUncompressed); }
+    bool Compress(const std::filesystem::path& Destination) { return ChangeType(Destination, TypeCompressed); }
+    bool DeltaEncode(const std::filesystem::path& Destination) { return ChangeType(Destination, TypeDelta); }
     void SortTable(void);
     static const Chain GetChain(const std::filesystem::path& Path, const size_t Index);
     static const Chain ComputeChain(const size_t Index, const size_t Min, const size_t Max, const size_t Length, const HashAlgorithm Algorithm, const std::string& Charset);
@@ -127,12 +231,30 @@ public:
     inline const TableRecord GetRecordAt(const size_t Index) const;
 private:
     // General purpose
-    void ChangeType(const std::filesystem::path& Destination, const TableType Type);
+    bool ChangeType(const std::filesystem::path& Destination, const TableType Type);
     std::optional<size_t> FindStartIndexForEndpoint(const uint64_t) const;
     std::optional<std::string> ValidateChain(const size_t ChainIndex, const uint8_t* Hash) const;
     bool TableMapped(void) { return m_MappedTableFd != nullptr; };
     bool MapTable(const bool ReadOnly = true);
     bool UnmapTable(void);
+    bool MapIndex(void);
+    bool UnmapIndex(void);
+    bool TableIndexed(void) const { return m_MappedIndexFd != nullptr; }
+    inline const size_t GetIndexedChain(const size_t Position) const;
+    inline const size_t GetSortedCount(void) const;
+    inline const size_t GetSortedChainAt(const size_t Position) const;
+    inline const uint64_t GetSortedEndpointAt(const size_t Position) const;
+    void PrefetchSortedAt(const size_t Position) const;
+    void PrefetchIndexedRecordAt(const size_t Position) const;
+    void LookupEndpoints(std::span<const uint64_t> Endpoints, std::span<size_t> Positions) const;
+    template <typename MatchFn>
+    void MatchEndpoints(std::span<const uint64_t> Endpoints, MatchFn&& Match) const;
+    bool LoadDeltaHeader(void);
+    cracktools::DeltaBlockReader GetDeltaBlock(const size_t Block) const;
+    template <typename RecordFn>
+    void ForEachRecord(RecordFn&& Fn) const;
+    template <typename Compare, typename OutputFn>
+    bool SortRecords(const std::filesystem::path& TempPrefix, Compare Comparator, OutputFn&& Output) const;
 #ifdef BIGINT
     static const mpz_class CalculateLowerBound(const size_t Min, const std::string& Charset) { return WordGenerator::WordLengthIndex(Min, Charset); };
     const mpz_class CalculateLowerBound(void) const { return CalculateLowerBound(m_Min, m_Charset); };
@@ -142,15 +264,26 @@ private:
 #endif
     // Building
     void StoreTableHeader(void) const;
-    void GenerateBlock(const size_t ThreadId, const size_t BlockId);
-    void SaveBlock(const size_t ThreadId, const size_t BlockId, const std::vector<TableRecord> Block, const uint64_t Time);
+    bool OpenJournal(void);
+    void GenerateBlock(const size_t ThreadId);
+    void SaveBlock(const size_t ThreadId, const size_t BlockId, std::vector<TableRecord> Block, const uint64_t Time);
+    std::vector<TableRecord> AcquireBlock(void);
+    void ReleaseBlock(std::vector<TableRecord> Block);
     void OutputStatus(const std::string_view LastEndpoint) const;
     void WriteBlock(const size_t BlockId, std::span<const TableRecord> Block);
     void BuildThreadCompleted(const size_t ThreadId);
+    bool WriteSortedBuild(void);
     // Cracking
     std::optional<std::string> CrackOne(const std::string& Target);
-    void CrackOneWorker(const size_t ThreadId, const std::vector<uint8_t> Target);
-    std::optional<std::string> CheckIteration(const HybridReducer& Reducer, const std::span<const uint8_t> Hash, const size_t Iteration) const;
+    void CrackOneWorker(const size_t ThreadId, std::span<const uint8_t> Target);
+    void RunOnWorkers(const std::function<void(const size_t)>& Task);
+    template <typename StartFn, typename CompletedFn>
+    void WalkChains(const HybridReducer& Reducer, const size_t Count, StartFn&& Start, CompletedFn&& Completed) const;
+    std::optional<std::string> CheckIterations(const HybridReducer& Reducer, const std::span<const uint8_t> Hash, std::span<const size_t> Iterations) const;
+    std::vector<std::optional<std::string>> CrackBatch(std::span<const std::string> Hashes);
+    void GenerateCandidates(const size_t ThreadId, std::span<const uint8_t> Targets, std::span<CrackCandidate> Candidates) const;
+    std::vector<std::tuple<size_t, size_t>> JoinCandidates(std::span<const CrackCandidate> Candidates) const;
+    void ValidateCandidates(const size_t ThreadId, std::span<const uint8_t> Targets, std::span<const std::tuple<size_t, size_t>> Hits, std::vector<std::optional<std::string>>& Results) const;
 
     // General purpose
     std::string m_Operation;
@@ -172,22 +305,48 @@ private:
     // For building
     size_t m_StartingChains = 0;
     FILE* m_WriteHandle = NULL;
-    size_t m_NextWriteBlock = 0;
-    std::map<size_t, const std::vector<TableRecord>> m_WriteCache;
+    FILE* m_JournalHandle = nullptr;
+    std::mutex m_BlockLock;
+    std::condition_variable m_BlockReleased;
+    size_t m_BlocksInFlight = 0;
+    std::vector<std::vector<TableRecord>> m_FreeBlocks;
+    std::vector<TableRecordCompressed> m_CompressedBlock;
+    std::chrono::steady_clock::time_point m_LastStatus;
+    uint64_t m_LastEndpoint = 0;
+    std::set<size_t> m_JournalBlocks;
+    std::atomic<size_t> m_NextBlock = 0;
+    std::atomic<bool> m_WriteFailed = false;
     size_t m_ThreadsCompleted = 0;
     size_t m_ChainsWritten = 0;
+    bool m_SortedBuild = false;
+    bool m_Perfect = false;
+    dispatch::DispatchPoolPtr m_SortPool;
+    std::unique_ptr<ExternalSort<TableRecord, TableRecordCompare>> m_BuildSort;
     std::map<size_t, uint64_t> m_ThreadTimers;
     // For cracking
     std::span<uint8_t> m_MappedTable;
     std::span<TableRecord> m_MappedTableRecords;
     std::span<TableRecordCompressed> m_MappedTableRecordsCompressed;
+    DeltaHeader m_DeltaHeader;
+    std::span<const DeltaBlock> m_DeltaBlocks;
+    std::span<const uint64_t> m_DeltaStartpoints;
+    std::span<const uint8_t> m_DeltaData;
     FILE* m_MappedTableFd = nullptr;
     bool m_MappedReadOnly = false;
+    bool m_UseIndex = true;
+    std::span<uint8_t> m_MappedIndex;
+    std::span<const uint32_t> m_MappedIndex32;
+    std::span<const uint64_t> m_MappedIndex64;
+    FILE* m_MappedIndexFd = nullptr;
+    bool m_AdviseLookups = false;
+    uint64_t m_EndpointMin = 0;
+    uint64_t m_EndpointMax = 0;
     std::ifstream m_HashFileStream;
     std::mutex m_HashFileStreamLock;
     char m_Separator = ':';
     std::atomic<bool> m_Cracked = false;
-    std::atomic<size_t> m_CrackingThreadsRunning = 0;
+    size_t m_BatchSize = 0;
+    size_t m_SortMemory = 0;
     std::vector<std::tuple<std::string, std::string>> m_CrackedResults;
     std::tuple<std::string, std::string> m_LastCracked;
 };
@@ -0,0 +1,658 @@
+//
+//  RuleSet.cpp
+//  CrackList
+//
+//  Created by Kryc on 16/10/2026.
+//  Copyright © 2026 Kryc. All rights reserved.
+//
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "RuleSet.hpp"
+
+// The longest word a rule can work on, matching hashcat
+#define MAX_RULE_WORD_LENGTH 256
+
+// The parameters taken by each rule function, N for a position
+// or length and C for a character. Null for unknown functions
+static const char*
+FunctionParameters(
+    const char Function
+)
+{
+    switch (Function)
+    {
+    case ':': case 'l': case 'u': case 'c': case 'C': case 't':
+    case 'r': case 'd': case 'f': case '{': case '}': case '[':
+    case ']': case 'q': case 'M': case '4': case '6': case 'Q':
+    case 'k': case 'K': case 'E':
+        return "";
+    case 'T': case 'p': case 'D': case '\'': case 'z': case 'Z':
+    case '<': case '>': case '_': case 'L': case 'R': case '+':
+    case '-': case '.': case ',': case 'y': case 'Y':
+        return "N";
+    case '$': case '^': case '@': case '!': case '/': case '(':
+    case ')': case 'e':
+        return "C";
+    case 'x': case 'O': case '*':
+        return "NN";
+    case 'i': case 'o': case '=': case '%': case '3':
+        return "NC";
+    case 's':
+        return "CC";
+    case 'X':
+        return "NNN";
+    default:
+        return nullptr;
+    }
+}
+
+// Positions are written 0-9 then A-Z
+static int
+DecodePosition(
+    const char Position
+)
+{
+    if (Position >= '0' && Position <= '9')
+    {
+        return Position - '0';
+    }
+    if (Position >= 'A' && Position <= 'Z')
+    {
+        return Position - 'A' + 10;
+    }
+    return -1;
+}
+
+static inline char
+Lower(
+    const char Character
+)
+{
+    return Character >= 'A' && Character <= 'Z' ? Character + ('a' - 'A') : Character;
+}
+
+static inline char
+Upper(
+    const char Character
+)
+{
+    return Character >= 'a' && Character <= 'z' ? Character - ('a' - 'A') : Character;
+}
+
+static inline char
+Toggle(
+    const char Character
+)
+{
+    return Character >= 'a' && Character <= 'z' ? Upper(Character) : Lower(Character);
+}
+
+/* static */ const bool
+RuleSet::IsLaneFunction(
+    const char Function
+)
+{
+    return strchr("lucCtT$^[]'s", Function) != nullptr;
+}
+
+const bool
+RuleSet::AddRule(
+    std::string_view Rule
+)
+{
+    std::vector<uint8_t> code;
+    bool lanes = true;
+    for (size_t i = 0; i < Rule.size(); i++)
+    {
+        const char function = Rule[i];
+        // Spaces and passthroughs separate functions and do nothing
+        if (function == ' ' || function == '\t' || function == ':')
+        {
+            continue;
+        }
+
+        const char* parameters = FunctionParameters(function);
+        if (parameters == nullptr)
+        {
+            return false;
+        }
+
+        lanes = lanes && IsLaneFunction(function);
+        code.push_back(function);
+        for (; *parameters != '\0'; parameters++)
+        {
+            if (++i == Rule.size())
+            {
+                return false;
+            }
+
+            if (*parameters == 'N')
+            {
+                const int position = DecodePosition(Rule[i]);
+                if (position < 0)
+                {
+                    return false;
+                }
+                code.push_back(position);
+            }
+            else
+            {
+                code.push_back(Rule[i]);
+            }
+        }
+    }
+
+    m_Code.insert(m_Code.end(), code.begin(), code.end());
+    m_Offsets.push_back(m_Code.size());
+    m_LaneRules.push_back(lanes);
+    return true;
+}
+
+const bool
+RuleSet::Load(
+    const std::filesystem::path& Path
+)
+{
+    std::ifstream infile(Path);
+    if (!infile.is_open())
+    {
+        std::cerr << "Unable to open rule file " << Path << std::endl;
+        return false;
+    }
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(infile, line))
+    {
+        lineNumber++;
+
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+
+        if (!AddRule(line))
+        {
+            std::cerr << "Invalid rule on line " << lineNumber << ": \"" << line << "\"" << std::endl;
+        }
+    }
+
+    return true;
+}
+
+const size_t
+RuleSet::Apply(
+    const size_t Rule,
+    std::string_view Word,
+    std::span<char> Destination
+) const
+{
+    const size_t capacity = std::min<size_t>(Destination.size(), MAX_RULE_WORD_LENGTH);
+    char* word = Destination.data();
+    size_t length = std::min(Word.size(), capacity);
+    memcpy(word, Word.data(), length);
+
+    // The memory starts out as the original word
+    std::array<char, MAX_RULE_WORD_LENGTH> memory;
+    size_t memoryLength = length;
+    memcpy(memory.data(), word, length);
+
+    const uint8_t* code = m_Code.data() + m_Offsets[Rule];
+    const uint8_t* end = m_Code.data() + m_Offsets[Rule + 1];
+    while (code < end)
+    {
+        const char function = *code++;
+        switch (function)
+        {
+        case 'l':
+            std::transform(word, word + length, word, Lower);
+            break;
+        case 'u':
+            std::transform(word, word + length, word, Upper);
+            break;
+        case 'c':
+            std::transform(word, word + length, word, Lower);
+            if (length > 0)
+            {
+                word[0] = Upper(word[0]);
+            }
+            break;
+        case 'C':
+            std::transform(word, word + length, word, Upper);
+            if (length > 0)
+            {
+                word[0] = Lower(word[0]);
+            }
+            break;
+        case 't':
+            std::transform(word, word + length, word, Toggle);
+            break;
+        case 'T':
+        {
+            const size_t n = *code++;
+            if (n < length)
+            {
+                word[n] = Toggle(word[n]);
+            }
+            break;
+        }
+        case 'r':
+            std::reverse(word, word + length);
+            break;
+        case 'd':
+            if (length * 2 <= capacity)
+            {
+                memcpy(word + length, word, length);
+                length *= 2;
+            }
+            break;
+        case 'p':
+        {
+            const size_t n = *code++;
+            if (length * (n + 1) <= capacity)
+            {
+                for (size_t i = 1; i <= n; i++)
+                {
+                    memcpy(word + length * i, word, length);
+                }
+                length *= n + 1;
+            }
+            break;
+        }
+        case 'f':
+            if (length * 2 <= capacity)
+            {
+                std::reverse_copy(word, word + length, word + length);
+                length *= 2;
+            }
+            break;
+        case '{':
+            if (length > 0)
+            {
+                std::rotate(word, word + 1, word + length);
+            }
+            break;
+        case '}':
+            if (length > 0)
+            {
+                std::rotate(word, word + length - 1, word + length);
+            }
+            break;
+        case '$':
+        {
+            const char c = *code++;
+            if (length < capacity)
+            {
+                word[length++] = c;
+            }
+            break;
+        }
+        case '^':
+        {
+            const char c = *code++;
+            if (length < capacity)
+            {
+                memmove(word + 1, word, length++);
+                word[0] = c;
+            }
+            break;
+        }
+        case '[':
+            if (length > 0)
+            {
+                memmove(word, word + 1, --length);
+            }
+            break;
+        case ']':
+            if (length > 0)
+            {
+                length--;
+            }
+            break;
+        case 'D':
+        {
+            const size_t n = *code++;
+            if (n < length)
+            {
+                memmove(word + n, word + n + 1, length - n - 1);
+                length--;
+            }
+            break;
+        }
+        case 'x':
+        {
+            const size_t n = *code++;
+            const size_t m = *code++;
+            if (n < length && n + m <= length)
+            {
+                memmove(word, word + n, m);
+                length = m;
+            }
+            break;
+        }
+        case 'O':
+        {
+            const size_t n = *code++;
+            const size_t m = *code++;
+            if (n < length && n + m <= length)
+            {
+                memmove(word + n, word + n + m, length - n - m);
+                length -= m;
+            }
+            break;
+        }
+        case 'i':
+        {
+            const size_t n = *code++;
+            const char c = *code++;
+            if (n <= length && length < capacity)
+            {
+                memmove(word + n + 1, word + n, length - n);
+                word[n] = c;
+                length++;
+            }
+            break;
+        }
+        case 'o':
+        {
+            const size_t n = *code++;
+            const char c = *code++;
+            if (n < length)
+            {
+                word[n] = c;
+            }
+            break;
+        }
+        case '\'':
+        {
+            const size_t n = *code++;
+            length = std::min(length, n);
+            break;
+        }
+        case 's':
+        {
+            const char from = *code++;
+            const char to = *code++;
+            std::replace(word, word + length, from, to);
+            break;
+        }
+        case '@':
+        {
+            const char c = *code++;
+            length = std::remove(word, word + length, c) - word;
+            break;
+        }
+        case 'z':
+        {
+            const size_t n = *code++;
+            if (length > 0 && length + n <= capacity)
+            {
+                memmove(word + n, word, length);
+                memset(word, word[n], n);
+                length += n;
+            }
+            break;
+        }
+        case 'Z':
+        {
+            const size_t n = *code++;
+            if (length > 0 && length + n <= capacity)
+            {
+                memset(word + length, word[length - 1], n);
+                length += n;
+            }
+            break;
+        }
+        case 'q':
+            if (length * 2 <= capacity)
+            {
+                for (size_t i = length; i-- > 0;)
+                {
+                    word[i * 2] = word[i];
+                    word[i * 2 + 1] = word[i];
+                }
+                length *= 2;
+            }
+            break;
+        case 'M':
+            memcpy(memory.data(), word, length);
+            memoryLength = length;
+            break;
+        case '4':
+            if (length + memoryLength <= capacity)
+            {
+                memcpy(word + length, memory.data(), memoryLength);
+                length += memoryLength;
+            }
+            break;
+        case '6':
+            if (length + memoryLength <= capacity)
+            {
+                memmove(word + memoryLength, word, length);
+                memcpy(word, memory.data(), memoryLength);
+                length += memoryLength;
+            }
+            break;
+        case 'X':
+        {
+            const size_t n = *code++;
+            const size_t m = *code++;
+            const size_t at = *code++;
+            if (n + m <= memoryLength && at <= length && length + m <= capacity)
+            {
+                memmove(word + at + m, word + at, length - at);
+                memcpy(word + at, memory.data() + n, m);
+                length += m;
+            }
+            break;
+        }
+        case 'Q':
+            if (length == memoryLength && memcmp(word, memory.data(), length) == 0)
+            {
+                return kRejected;
+            }
+            break;
+        case '<':
+            if (length > *code++)
+            {
+                return kRejected;
+            }
+            break;
+        case '>':
+            if (length < *code++)
+            {
+                return kRejected;
+            }
+            break;
+        case '_':
+            if (length != *code++)
+            {
+                return kRejected;
+            }
+            break;
+        case '!':
+            if (std::find(word, word + length, (char)*code++) != word + length)
+            {
+                return kRejected;
+            }
+            break;
+        case '/':
+            if (std::find(word, word + length, (char)*code++) == word + length)
+            {
+                return kRejected;
+            }
+            break;
+        case '(':
+            if (length == 0 || word[0] != (char)*code++)
+            {
+                return kRejected;
+            }
+            break;
+        case ')':
+            if (length == 0 || word[length - 1] != (char)*code++)
+            {
+                return kRejected;
+            }
+            break;
+        case '=':
+        {
+            const size_t n = *code++;
+            const char c = *code++;
+            if (n >= length || word[n] != c)
+            {
+                return kRejected;
+            }
+            break;
+        }
+        case '%':
+        {
+            const size_t n = *code++;
+            const char c = *code++;
+            if ((size_t)std::count(word, word + length, c) < n)
+            {
+                return kRejected;
+            }
+            break;
+        }
+        case 'k':
+            if (length >= 2)
+            {
+                std::swap(word[0], word[1]);
+            }
+            break;
+        case 'K':
+            if (length >= 2)
+            {
+                std::swap(word[length - 2], word[length - 1]);
+            }
+            break;
+        case '*':
+        {
+            const size_t n = *code++;
+            const size_t m = *code++;
+            if (n < length && m < length)
+            {
+                std::swap(word[n], word[m]);
+            }
+            break;
+        }
+        case 'L':
+        {
+            const size_t n = *code++;
+            if (n < length)
+            {
+                word[n] = (uint8_t)word[n] << 1;
+            }
+            break;
+        }
+        case 'R':
+        {
+            const size_t n = *code++;
+            if (n < length)
+            {
+                word[n] = (uint8_t)word[n] >> 1;
+            }
+            break;
+        }
+        case '+':
+        {
+            const size_t n = *code++;
+            if (n < length)
+            {
+                word[n]++;
+            }
+            break;
+        }
+        case '-':
+        {
+            const size_t n = *code++;
+            if (n < length)
+            {
+                word[n]--;
+            }
+            break;
+        }
+        case '.':
+        {
+            const size_t n = *code++;
+            if (n + 1 < length)
+            {
+                word[n] = word[n + 1];
+            }
+            break;
+        }
+        case ',':
+        {
+            const size_t n = *code++;
+            if (n >= 1 && n < length)
+            {
+                word[n] = word[n - 1];
+            }
+            break;
+        }
+        case 'y':
+        {
+            const size_t n = *code++;
+            if (n <= length && length + n <= capacity)
+            {
+                memmove(word + n, word, length);
+                memcpy(word, word + n, n);
+                length += n;
+            }
+            break;
+        }
+        case 'Y':
+        {
+            const size_t n = *code++;
+            if (n <= length && length + n <= capacity)
+            {
+                memcpy(word + length, word + length - n, n);
+                length += n;
+            }
+            break;
+        }
+        case 'E':
+        case 'e':
+        {
+            const char separator = function == 'E' ? ' ' : *code++;
+            std::transform(word, word + length, word, Lower);
+            for (size_t i = 0; i < length; i++)
+            {
+                if (i == 0 || word[i - 1] == separator)
+                {
+                    word[i] = Upper(word[i]);
+                }
+            }
+            break;
+        }
+        case '3':
+        {
+            const size_t n = *code++;
+            const char separator = *code++;
+            size_t seen = 0;
+            for (size_t i = 0; i + 1 < length; i++)
+            {
+                if (word[i] == separator && seen++ == n)
+                {
+                    word[i + 1] = Toggle(word[i + 1]);
+                    break;
+                }
+            }
+            break;
+        }
+        }
+    }
+
+    return length;
+}
@@ -0,0 +1,77 @@
+//
+//  RuleSet.hpp
+//  CrackList
+//
+//  Created by Kryc on 16/10/2026.
+//  Copyright © 2026 Kryc. All rights reserved.
+//
+
+#ifndef RuleSet_hpp
+#define RuleSet_hpp
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+
+// A list of hashcat rules compiled once into a compact bytecode. Each
+// rule is stored as its functions back to back, every function byte
+// followed by its parameters with positions already decoded, so applying
+// a rule is a single pass over its bytes with no parsing
+class RuleSet
+{
+public:
+    // Returned by Apply when a rejection function drops the word
+    static constexpr size_t kRejected = SIZE_MAX;
+    RuleSet(void) = default;
+    // Compiles a single rule, false if it is not valid
+    const bool AddRule(std::string_view Rule);
+    // Compiles every rule in a hashcat rule file. Invalid rules
+    // are reported and skipped, false if the file can not be read
+    const bool Load(const std::filesystem::path& Path);
+    const size_t GetCount(void) const { return m_Offsets.size() - 1; }
+    const bool Empty(void) const { return GetCount() == 0; }
+    // Writes the word with the rule applied to the destination and returns
+    // its length, or kRejected. Functions which would grow the word past
+    // the destination leave it unchanged, as hashcat does
+    const size_t Apply(const size_t Rule, std::string_view Word, std::span<char> Destination) const;
+    // Rules made only of functions a TransposedBuffer can apply to every
+    // lane at once, such as case changes, appends and substitutions
+    const bool IsLaneRule(const size_t Rule) const { return m_LaneRules[Rule]; }
+    template <typename Buffer>
+    void ApplyLanes(
+        const size_t Rule,
+        Buffer& Lanes
+    ) const
+    {
+        const uint8_t* code = m_Code.data() + m_Offsets[Rule];
+        const uint8_t* end = m_Code.data() + m_Offsets[Rule + 1];
+        while (code < end)
+        {
+            switch (*code++)
+            {
+            case 'l': Lanes.Lower(); break;
+            case 'u': Lanes.Upper(); break;
+            case 'c': Lanes.Capitalize(); break;
+            case 'C': Lanes.InvertCapitalize(); break;
+            case 't': Lanes.Toggle(); break;
+            case 'T': Lanes.ToggleAt(*code++); break;
+            case '$': Lanes.Append(*code++); break;
+            case '^': Lanes.Prepend(*code++); break;
+            case '[': Lanes.DeleteFirst(); break;
+            case ']': Lanes.DeleteLast(); break;
+            case '\'': Lanes.Truncate(*code++); break;
+            case 's': Lanes.Replace(code[0], code[1]); code += 2; break;
+            }
+        }
+    }
+private:
+    static const bool IsLaneFunction(const char Function);
+
+    std::vector<uint8_t> m_Code;
+    std::vector<uint32_t> m_Offsets = { 0 };
+    std::vector<bool> m_LaneRules;
+};
+
+#endif /* RuleSet_hpp */
@@ -8,11 +8,13 @@
 
 #include <algorithm>
 #include <chrono>
+#include <format>
 #include <fstream>
 #include <cinttypes>
 #include <gmp.h>
 #include <mutex>
 #include <span>
+#include <type_traits>
 #include <sys/mman.h>
 
 #include "SimdCrack.hpp"
@@ -48,24 +50,46 @@ SimdCrack::InitAndRun(
         m_Threads = std::thread::hardware_concurrency();
     }
 
-    m_Generator = WordGenerator(m_Charset, m_Prefix, m_Postfix);
-
-    m_Resume = m_Generator.WordLengthIndex(m_Min);
-
-    m_Limit = m_Generator.WordLengthIndex(m_Max + 1);
+    if (!m_MaskPattern.empty())
+    {
+        if (!InitMasks())
+        {
+            dispatch::CurrentDispatcher()->Stop();
+            return;
+        }
+    }
+    else
+    {
+        m_Generator = WordGenerator(m_Charset, m_Prefix, m_Postfix);
+        m_First = m_Generator.WordLengthIndex(m_Min);
+        m_Limit = m_Generator.WordLengthIndex(m_Max + 1);
+        m_Resume = m_First;
 
-    if (!m_ResumeString.empty())
-	{
-		m_Resume = m_Generator.Parse(m_ResumeString);
-		std::cout << "Resuming from '" << m_ResumeString << "' (Index " << m_Resume.get_str() << ") " << std::endl;
-	}
+        if (!m_ResumeString.empty())
+        {
+            // The resume word was the last one tried
+            m_Resume = m_Generator.Parse(m_ResumeString) + 1;
+            std::cout << "Resuming from '" << m_ResumeString << "' (Index " << m_Resume.get_str() << ") " << std::endl;
+        }
+    }
 
     if(!ProcessHashList())
     {
         return;
     }
 
-    std::cerr << "Using character set: " << m_Charset << std::endl;
+    if (m_Masks.size() == 1)
+    {
+        std::cerr << "Using mask: " << m_Masks[0].mask.GetPattern() << std::endl;
+    }
+    else if (!m_Masks.empty())
+    {
+        std::cerr << "Using " << m_Masks.size() << " masks from " << m_MaskPattern << std::endl;
+    }
+    else
+    {
+        std::cerr << "Using character set: " << m_Charset << std::endl;
+    }
 
     //
     // Open the output file handle
@@ -79,17 +103,229 @@ SimdCrack::InitAndRun(
 
     std::cerr << "Starting cracking using " << m_Threads << " threads" << std::endl;
 
-    for (size_t i = 0; i < m_Threads; i++)
+    // Use the narrowest integer the keyspace fits in, leaving headroom
+    // for threads claiming blocks past the end, so GMP is only used when
+    // the keyspace really needs it
+    if (m_Limit < mpz_class(1) << 63)
+    {
+        StartWorkers<uint64_t>();
+    }
+    else if (m_Limit < mpz_class(1) << 127)
+    {
+        StartWorkers<unsigned __int128>();
+    }
+    else
+    {
+        StartWorkers<mpz_class>();
+    }
+}
+
+bool
+SimdCrack::InitMasks(
+    void
+)
+{
+    // A .hcmask file holds a mask per line, each optionally
+    // preceded by its own custom charsets
+    const bool maskFile = std::filesystem::path(m_MaskPattern).extension() == ".hcmask";
+    std::vector<std::string> lines;
+    if (maskFile)
+    {
+        std::ifstream infile(m_MaskPattern);
+        if (!infile.is_open())
+        {
+            std::cerr << "Unable to open mask file " << m_MaskPattern << std::endl;
+            return false;
+        }
+
+        std::string line;
+        while (std::getline(infile, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.pop_back();
+            }
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            lines.push_back(std::move(line));
+        }
+    }
+    else
+    {
+        lines.push_back(m_MaskPattern);
+    }
+
+    mpz_class start = 0;
+    for (const auto& line : lines)
+    {
+        auto mask = maskFile ? Mask::ParseLine(line, m_CustomCharsets) : Mask::Parse(line, m_CustomCharsets);
+        if (!mask.has_value())
+        {
+            std::cerr << "Invalid mask: " << line << std::endl;
+            return false;
+        }
+
+        // Without increment only words filling the whole mask are tried,
+        // otherwise --min and --max pick the lengths within the mask
+        size_t min = mask->GetLength();
+        size_t max = mask->GetLength();
+        if (m_Increment)
+        {
+            min = std::clamp<size_t>(m_Min, 1, mask->GetLength());
+            max = std::clamp<size_t>(m_Max, min, mask->GetLength());
+        }
+
+        MaskRange range;
+        range.start = start;
+        range.first = mask->LengthIndex(min);
+        range.keyspace = mask->LengthIndex(max + 1) - range.first;
+        range.mask = std::move(*mask);
+        start += range.keyspace;
+        m_Masks.push_back(std::move(range));
+    }
+
+    if (m_Masks.empty())
+    {
+        std::cerr << "No masks found in " << m_MaskPattern << std::endl;
+        return false;
+    }
+
+    m_First = 0;
+    m_Limit = start;
+    m_Resume = 0;
+
+    if (!m_ResumeString.empty())
+    {
+        // A word may match more than one mask of a file
+        if (m_Masks.size() > 1)
+        {
+            std::cerr << "Resuming is only supported with a single mask" << std::endl;
+            return false;
+        }
+
+        const MaskRange& range = m_Masks[0];
+        auto index = range.mask.Index(m_ResumeString);
+        if (!index.has_value() || *index < range.first)
+        {
+            std::cerr << "Resume word '" << m_ResumeString << "' does not match the mask" << std::endl;
+            return false;
+        }
+        m_Resume = *index + 1 - range.first;
+        std::cout << "Resuming from '" << m_ResumeString << "' (Index " << m_Resume.get_str() << ") " << std::endl;
+    }
+
+    return true;
+}
+
+size_t
+SimdCrack::MaskAt(
+    const mpz_class& Index
+) const
+{
+    auto next = std::upper_bound(
+        m_Masks.begin(),
+        m_Masks.end(),
+        Index,
+        [](const mpz_class& Value, const MaskRange& Range) {
+            return Value < Range.start;
+        }
+    );
+    return std::max<size_t>(next - m_Masks.begin(), 1) - 1;
+}
+
+std::string
+SimdCrack::WordAt(
+    const mpz_class& Index
+)
+{
+    if (!m_Masks.empty())
+    {
+        const MaskRange& range = m_Masks[MaskAt(Index)];
+        MaskOdometer odometer(range.mask, m_Prefix, m_Postfix);
+        odometer.Seek(mpz_class(Index - range.start + range.first));
+        return std::string(odometer.Get());
+    }
+    return m_Generator.Generate(Index);
+}
+
+template <typename T>
+static T
+FromMpz(
+    const mpz_class& Value
+)
+{
+    if constexpr (std::is_same_v<T, mpz_class>)
+    {
+        return Value;
+    }
+    else if constexpr (std::is_same_v<T, uint64_t>)
+    {
+        return Value.get_ui();
+    }
+    else
+    {
+        const mpz_class high = Value >> 64;
+        const mpz_class low = Value - (high << 64);
+        return ((T)high.get_ui() << 64) | (T)low.get_ui();
+    }
+}
+
+template <typename T>
+static mpz_class
+ToMpz(
+    const T& Value
+)
+{
+    if constexpr (std::is_same_v<T, mpz_class>)
+    {
+        return Value;
+    }
+    else if constexpr (std::is_same_v<T, uint64_t>)
+    {
+        return mpz_class(Value);
+    }
+    else
+    {
+        return (mpz_class((uint64_t)(Value >> 64)) << 64) + (uint64_t)Value;
+    }
+}
+
+template <typename T>
+static size_t
+ToSize(
+    const T& Value
+)
+{
+    if constexpr (std::is_same_v<T, mpz_class>)
+    {
+        return Value.get_ui();
+    }
+    else
     {
-        mpz_class start(m_Resume + i + 1);
+        return (size_t)Value;
+    }
+}
+
+template <typename T>
+void
+SimdCrack::StartWorkers(
+    void
+)
+{
+    const T start = FromMpz<T>(m_Resume);
+    const T limit = FromMpz<T>(m_Limit);
 
+    for (size_t i = 0; i < m_Threads; i++)
+    {
         m_DispatchPool->PostTask(
             dispatch::bind(
-                &SimdCrack::GenerateBlocks,
+                &SimdCrack::GenerateBlocks<T>,
                 this,
                 i,
-                std::move(start),
-                m_Threads
+                start,
+                limit
             )
         );
     }
@@ -282,47 +518,28 @@ SimdCrack::ThreadCompleted(
     }
 }
 
+template <typename Odometer>
 void
-SimdCrack::GenerateBlocks(
-    const size_t ThreadId,
-    const mpz_class Start,
-    const size_t Step
-)
+SimdCrack::HashWords(
+    Odometer& Words,
+    size_t Count,
+    std::vector<std::tuple<std::string, std::string>>& Results
+) const
 {
-    mpz_class index(Start);
     SimdHashBufferFixed<MAX_OPTIMIZED_BUFFER_SIZE> words;
     std::array<uint8_t, MAX_HASH_SIZE * MAX_LANES> hashes;
     std::span<uint8_t, MAX_HASH_SIZE * MAX_LANES> hashspan(hashes);
-    std::vector<std::tuple<std::string, std::string>> results;
 
-    // Check if we should end
-    if (index >= m_Limit)
-    {
-        dispatch::PostTaskToDispatcher(
-            "main",
-            dispatch::bind(
-                &SimdCrack::ThreadCompleted,
-                this,
-                ThreadId
-            )
-        );
-        return;
-    }
-
-    auto start = std::chrono::system_clock::now();
-
-    for (
-        size_t counter = 0;
-        counter < m_Blocksize && index < m_Limit;
-        counter++
-    )
+    while (Count > 0)
     {
+        // Lanes past the end of the block are left empty and
+        // ignored as their words belong to the next block
+        const size_t lanes = std::min(Count, SimdLanes());
         for (size_t i = 0; i < SimdLanes(); i++)
         {
-            const std::string word = m_Generator.Generate(index);
-            words.Set(i, word);
-            index += Step;
+            words.SetLength(i, i < lanes ? Words.Next(words.GetBufferChar(i)) : 0);
         }
+        Count -= lanes;
 
         SimdHashOptimized(
             m_Algorithm,
@@ -331,19 +548,86 @@ SimdCrack::GenerateBlocks(
             &hashes[0]
         );
         
-        for (size_t i = 0; i < SimdLanes(); i++)
+        for (size_t i = 0; i < lanes; i++)
         {
             auto hash = hashspan.subspan(i * m_HashWidth, m_HashWidth);
 
             if (m_HashList.Lookup(hash))
             {
-                results.push_back({
+                Results.push_back({
                     Util::ToHex(hash),
                     words.GetString(i)
                 });
             }
         }
     }
+}
+
+template <typename T>
+void
+SimdCrack::GenerateBlocks(
+    const size_t ThreadId,
+    const T Start,
+    const T Limit
+)
+{
+    // Threads claim the next block of words as they finish
+    // their last, so faster threads get through more blocks
+    const size_t blockWords = m_Blocksize * SimdLanes();
+    const T index = Start + T(m_NextBlock++) * blockWords;
+    T blockEnd = index + blockWords;
+    if (blockEnd > Limit)
+    {
+        blockEnd = Limit;
+    }
+
+    std::vector<std::tuple<std::string, std::string>> results;
+
+    // Check if we should end
+    if (index >= Limit)
+    {
+        dispatch::PostTaskToDispatcher(
+            "main",
+            dispatch::bind(
+                &SimdCrack::ThreadCompleted,
+                this,
+                ThreadId
+            )
+        );
+        return;
+    }
+
+    auto start = std::chrono::system_clock::now();
+
+    // Words are stepped through from the start of the block
+    // so no bignum work is done per word
+    if (m_Masks.empty())
+    {
+        WordOdometer odometer(m_Charset, m_Prefix, m_Postfix);
+        odometer.Seek(index);
+        HashWords(odometer, ToSize<T>(blockEnd - index), results);
+    }
+    else
+    {
+        // Blocks carry on into the next mask when one runs out, so
+        // threads move between masks without waiting on each other
+        T next = index;
+        for (size_t mask = MaskAt(ToMpz(next)); next < blockEnd; mask++)
+        {
+            const MaskRange& range = m_Masks[mask];
+            T end = blockEnd;
+            if (mask + 1 < m_Masks.size() && FromMpz<T>(m_Masks[mask + 1].start) < end)
+            {
+                end = FromMpz<T>(m_Masks[mask + 1].start);
+            }
+
+            const T local = next - FromMpz<T>(range.start) + FromMpz<T>(range.first);
+            MaskOdometer odometer(range.mask, m_Prefix, m_Postfix);
+            odometer.Seek(local);
+            HashWords(odometer, ToSize<T>(end - next), results);
+            next = end;
+        }
+    }
 
     auto end = std::chrono::system_clock::now();
     auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
@@ -367,17 +651,17 @@ SimdCrack::GenerateBlocks(
             this,
             ThreadId,
             elapsed_ms.count(),
-            index
+            ToMpz(blockEnd)
         )
     );
 
     dispatch::PostTaskFast(
         dispatch::bind(
-            &SimdCrack::GenerateBlocks,
+            &SimdCrack::GenerateBlocks<T>,
             this,
             ThreadId,
-            index,
-            Step
+            Start,
+            Limit
         )
     );
 }
@@ -396,28 +680,49 @@ SimdCrack::ThreadPulse(
 
     if (!m_Outfile.empty() && ThreadId == 0)
     {
-        // Get the upper and lower bound for this current length
+        // Progress through the lengths being cracked
         std::string diffch, ooch;
-        auto lower = m_Generator.WordLengthIndex(m_Min);
-        auto upper = m_Generator.WordLengthIndex(m_Max + 1);
-
-        mpz_class diff = Last - lower;
-        mpz_class outof = upper - lower;
+        mpz_class diff = Last - m_First;
+        mpz_class outof = m_Limit - m_First;
         mpf_class percent = (mpf_class(diff) * 100)/ outof;
         diff = Util::NumFactor(diff, diffch);
         outof = Util::NumFactor(outof, ooch);
 
-        uint64_t averageMs = 0;
+        // Threads run at different speeds so the
+        // overall rate is the sum of their rates
+        double hashesPerSec = 0.f;
         for (auto const& [thread, val] : m_LastBlockMs)
         {
-            averageMs += val;
+            hashesPerSec += (double)(m_Blocksize * SimdLanes() * 1000) / std::max<uint64_t>(val, 1);
         }
-        averageMs /= m_Threads;
-        
-        double hashesPerSec = (double)(m_Blocksize * 1000 * m_Threads) / averageMs;
         std::string multiplechar;
         hashesPerSec = Util::NumFactor(hashesPerSec, multiplechar);
 
+        // Masks each report their own progress as small
+        // ones come and go between status updates
+        std::string maskStatus;
+        if (m_Masks.size() > 1)
+        {
+            const size_t mask = MaskAt(Last > 0 ? mpz_class(Last - 1) : Last);
+            const MaskRange& range = m_Masks[mask];
+            std::string donech, ksch;
+            mpz_class done = Last - range.start;
+            mpf_class maskPercent = (mpf_class(done) * 100) / range.keyspace;
+            done = Util::NumFactor(done, donech);
+            mpz_class keyspace = Util::NumFactor(range.keyspace, ksch);
+            maskStatus = std::format(
+                " M:{}/{} \"{}\" {}{}/{}{} ({:.1f}%)",
+                mask + 1,
+                m_Masks.size(),
+                range.mask.GetPattern(),
+                done.get_str(),
+                donech,
+                keyspace.get_str(),
+                ksch,
+                maskPercent.get_d()
+            );
+        }
+
         // Print the status
         std::string status = std::format(
             "H/s: {:.1f}{} C:{}/{} L:\"{}\" C:\"{}\" #:{}{}/{}{} ({:.1f}%)",
@@ -426,7 +731,7 @@ SimdCrack::ThreadPulse(
             m_Found,
             m_TargetsCount,
             m_LastWord,
-            m_Generator.Generate(Last),
+            WordAt(Last),
             diff.get_str(),
             diffch,
             outof.get_str(),
@@ -434,6 +739,6 @@ SimdCrack::ThreadPulse(
             percent.get_d()
         );
 
-        std::cerr << "\r" << status << std::flush;
+        std::cerr << "\r" << status << maskStatus << std::flush;
     }
 }
\ No newline at end of file
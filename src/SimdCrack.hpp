@@ -9,6 +9,7 @@
 #ifndef SimdCrack_hpp
 #define SimdCrack_hpp
 
+#include <atomic>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
@@ -28,6 +29,17 @@
 #include "SharedRefptr.hpp"
 #include "simdhash.h"
 
+// A mask and the range of the combined keyspace it covers. Masks from
+// a .hcmask file run one after another, so each starts where the one
+// before it ends
+typedef struct _MaskRange
+{
+    Mask mask;
+    mpz_class start;
+    mpz_class first;
+    mpz_class keyspace;
+} MaskRange;
+
 class SimdCrack
 {
 public:
@@ -43,6 +55,9 @@ public:
     void SetPostfix(const std::string& Postfix) { m_Postfix = Postfix; }
     void SetCharset(const std::string& Charset) { m_Charset = ParseCharset(Charset); }
     void SetExtra(const std::string& Charset) { m_Charset += ParseCharset(Charset); }
+    void SetMask(const std::string& Mask) { m_MaskPattern = Mask; }
+    void SetCustomCharset(const size_t Index, const std::string& Charset) { m_CustomCharsets.at(Index) = Charset; }
+    void SetIncrement(const bool Increment) { m_Increment = Increment; }
     void AddTarget(const std::string& Target) { m_Target.push_back(Target); }
     void SetMin(const size_t Min) { m_Min = Min; }
     void SetMax(const size_t Max) { m_Max = Max; }
@@ -53,7 +68,15 @@ public:
     const char GetSeparator(void) const { return m_Separator; }
     const bool GetHexlify(void) const { return m_Hexlify; }
 private:
-    void GenerateBlocks(const size_t ThreadId, const mpz_class Start, const size_t Step);
+    template <typename T>
+    void StartWorkers(void);
+    template <typename T>
+    void GenerateBlocks(const size_t ThreadId, const T Start, const T Limit);
+    template <typename Odometer>
+    void HashWords(Odometer& Words, size_t Count, std::vector<std::tuple<std::string, std::string>>& Results) const;
+    bool InitMasks(void);
+    size_t MaskAt(const mpz_class& Index) const;
+    std::string WordAt(const mpz_class& Index);
     void FoundResults(std::vector<std::tuple<std::string, std::string>> Results);
     bool ProcessHashList(void);
     bool AddHashToList(const std::string_view Hash);
@@ -88,10 +111,16 @@ private:
     std::string m_Postfix;
     std::string m_Charset = ASCII;
     std::string m_ResumeString;
+    std::string m_MaskPattern;
+    std::vector<MaskRange> m_Masks;
+    std::vector<std::string> m_CustomCharsets = std::vector<std::string>(4);
+    bool m_Increment = false;
+    mpz_class m_First;
     size_t m_Min = 1;
     size_t m_Max = MAX_OPTIMIZED_BUFFER_SIZE;
     mpz_class m_Limit;
     size_t m_ThreadsCompleted = 0;
+    std::atomic<size_t> m_NextBlock = 0;
     char m_Separator = ':';
     size_t m_BitmaskSize = 16;
 };
@@ -38,6 +38,9 @@ Options:
   --postfix, -a <string>        Add a postfix to all generated passwords.
   --charset, -c <string>        Specify the character set to use.
   --extra, -e <string>          Add extra characters to the character set.
+  --mask, -m <mask>             Generate words from a mask (e.g., ?u?l?l?l?d?d) or .hcmask file.
+  --custom1..4, -1..-4 <chars>  Define the custom mask charsets ?1 to ?4.
+  --increment, -i               Try the lengths of the mask between --min and --max.
   --bitmask <value>             Set the bitmask size.
   --sha256                      Use the SHA-256 hash algorithm.
   --sha1                        Use the SHA-1 hash algorithm.
@@ -129,6 +132,25 @@ int main(
 			ARGCHECK();
 			simdcrack.SetExtra(args[++i]);
 		}
+		else if (arg == "--mask" || arg == "-m")
+		{
+			ARGCHECK();
+			simdcrack.SetMask(args[++i]);
+		}
+		else if (arg.size() == 2 && arg[0] == '-' && arg[1] >= '1' && arg[1] <= '4')
+		{
+			ARGCHECK();
+			simdcrack.SetCustomCharset(arg[1] - '1', args[++i]);
+		}
+		else if (arg.size() == 9 && arg.starts_with("--custom") && arg[8] >= '1' && arg[8] <= '4')
+		{
+			ARGCHECK();
+			simdcrack.SetCustomCharset(arg[8] - '1', args[++i]);
+		}
+		else if (arg == "--increment" || arg == "-i")
+		{
+			simdcrack.SetIncrement(true);
+		}
 		else if (arg == "--bitmask")
 		{
 			ARGCHECK();
@@ -26,6 +26,8 @@ Actions:
   info        Display information about the rainbow table.
   compress    Compress the rainbow table.
   decompress  Decompress the rainbow table.
+  delta       Convert the rainbow table to a delta encoded table.
+  index       Build the endpoint index for a compressed table.
 
 Options:
   --min <value>       Set the minimum password length.
@@ -37,6 +39,12 @@ Options:
   --threads <value>   Set the number of threads.
   --algorithm <name>  Set the hash algorithm (e.g., md5, sha1).
   --noindex           Disable indexing.
+  --decompressed      Build an uncompressed table.
+  --delta             Build a delta encoded table (requires --sorted).
+  --sorted            Build a table sorted by endpoint.
+  --perfect           Build a sorted table without merged chains.
+  --batch <value>     Set the number of hashes cracked together.
+  --memory <value>    Set the memory used for sorting in MB.
   --help              Display this help message.
 )";
 
@@ -141,6 +149,33 @@ main(
         {
             rainbow.SetType(TypeUncompressed);
         }
+        else if (arg == "--delta")
+        {
+            rainbow.SetType(TypeDelta);
+        }
+        else if (arg == "--sorted")
+        {
+            rainbow.SetSortedBuild(true);
+        }
+        else if (arg == "--perfect")
+        {
+            rainbow.SetSortedBuild(true);
+            rainbow.SetPerfect(true);
+        }
+        else if (arg == "--noindex")
+        {
+            rainbow.SetUseIndex(false);
+        }
+        else if (arg == "--batch")
+        {
+            ARGCHECK();
+            rainbow.SetBatchSize(std::atoi(args[++i].c_str()));
+        }
+        else if (arg == "--memory")
+        {
+            ARGCHECK();
+            rainbow.SetSortMemory(std::atoll(args[++i].c_str()) * 1024 * 1024);
+        }
         else if (arg == "--algorithm")
         {
             ARGCHECK();
@@ -184,7 +219,7 @@ main(
         {
             target = args[i];
         }
-        else if (action == "decompress" || action == "compress")
+        else if (action == "decompress" || action == "compress" || action == "delta")
         {
             destination = args[i];
         }
@@ -198,7 +233,10 @@ main(
             return 1;
         }
 
-        rainbow.InitAndRunBuild();
+        if (!rainbow.InitAndRunBuild())
+        {
+            return 1;
+        }
     }
     else if (action == "crack")
     {
@@ -210,7 +248,7 @@ main(
 
         rainbow.Crack(target);
     }
-    else if (action == "decompress" || action == "compress")
+    else if (action == "decompress" || action == "compress" || action == "delta")
     {
         if (!rainbow.ValidTable())
         {
@@ -232,11 +270,40 @@ main(
                 auto extension = tablepath.extension();
                 destination = tablepath.replace_extension(".utbl");
             }
-            rainbow.Decompress(destination);
+            if (!rainbow.Decompress(destination))
+            {
+                return 1;
+            }
         }
-        else
+        else if (action == "delta")
         {
-            rainbow.Compress(destination);
+            if (destination.empty())
+            {
+                auto tablepath = rainbow.GetPath();
+                destination = tablepath.replace_extension(".dtbl");
+            }
+            if (!rainbow.DeltaEncode(destination))
+            {
+                return 1;
+            }
+        }
+        else if (!rainbow.Compress(destination))
+        {
+            return 1;
+        }
+    }
+    else if (action == "index")
+    {
+        int check = VerifyAndLoad(rainbow);
+        if (check != 0)
+        {
+            return check;
+        }
+
+        if (!rainbow.BuildIndex())
+        {
+            std::cerr << "Error building table index" << std::endl;
+            return 1;
         }
     }
     else if (action == "info")
@@ -268,6 +335,10 @@ main(
         std::cout << "Charset:     \"" << rainbow.GetCharset() << "\"" << std::endl;
         std::cout << "Charset Len: " << rainbow.GetCharset().size() << std::endl;
         std::cout << "KS Coverage: " << rainbow.GetCoverage() << std::endl;
+        if (rainbow.GetTableType() == TypeCompressed)
+        {
+            std::cout << "Indexed:     " << (rainbow.IndexExists() ? "Yes" : "No") << std::endl;
+        }
     }
     else if (action == "test")
     {
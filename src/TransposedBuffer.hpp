@@ -0,0 +1,197 @@
+//
+//  TransposedBuffer.hpp
+//  CrackList
+//
+//  Created by Kryc on 16/10/2026.
+//  Copyright © 2026 Kryc. All rights reserved.
+//
+
+#ifndef TransposedBuffer_hpp
+#define TransposedBuffer_hpp
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <string_view>
+
+#include "simdhash.h"
+
+// Candidate words held struct of arrays style, with byte i of every lane
+// stored next to each other in row i. Applying the same change to all
+// lanes then works on whole rows, which the compiler turns into vector
+// instructions, rather than on each word in turn. Rows past the end of
+// a word hold junk which is changed along with the rest and ignored
+template <size_t N>
+class TransposedBuffer
+{
+public:
+    TransposedBuffer(void) { Clear(); }
+    void Clear(void)
+    {
+        m_Lengths.fill(0);
+        m_RowsUsed = 0;
+    }
+    void Set(
+        const size_t Lane,
+        std::string_view Word
+    )
+    {
+        const size_t length = std::min(Word.size(), N);
+        for (size_t i = 0; i < length; i++)
+        {
+            m_Rows[i][Lane] = Word[i];
+        }
+        m_Lengths[Lane] = length;
+        m_RowsUsed = std::max(m_RowsUsed, length);
+    }
+    const size_t GetLength(const size_t Lane) const { return m_Lengths[Lane]; }
+    // Copies the lanes out of the transposed layout
+    const size_t Get(
+        const size_t Lane,
+        std::span<char> Destination
+    ) const
+    {
+        const size_t length = std::min(m_Lengths[Lane], Destination.size());
+        for (size_t i = 0; i < length; i++)
+        {
+            Destination[i] = m_Rows[i][Lane];
+        }
+        return length;
+    }
+    // Fills the first Count lanes of a SimdHashBufferFixed
+    template <typename Buffer>
+    void Store(
+        Buffer& Words,
+        const size_t Count
+    ) const
+    {
+        for (size_t lane = 0; lane < Count; lane++)
+        {
+            Words.SetLength(lane, Get(lane, Words.GetBufferChar(lane)));
+        }
+    }
+    // Copies only the rows in use
+    void CopyFrom(
+        const TransposedBuffer& Other
+    )
+    {
+        memcpy(m_Rows.data(), Other.m_Rows.data(), Other.m_RowsUsed * MAX_LANES);
+        m_Lengths = Other.m_Lengths;
+        m_RowsUsed = Other.m_RowsUsed;
+    }
+    void Lower(void) { Transform(0, m_RowsUsed, LowerByte); }
+    void Upper(void) { Transform(0, m_RowsUsed, UpperByte); }
+    void Toggle(void) { Transform(0, m_RowsUsed, ToggleByte); }
+    void ToggleAt(const size_t Position) { Transform(Position, std::min(Position + 1, m_RowsUsed), ToggleByte); }
+    void Capitalize(void) { Lower(); Transform(0, std::min<size_t>(1, m_RowsUsed), UpperByte); }
+    void InvertCapitalize(void) { Upper(); Transform(0, std::min<size_t>(1, m_RowsUsed), LowerByte); }
+    void Replace(
+        const char From,
+        const char To
+    )
+    {
+        for (size_t i = 0; i < m_RowsUsed; i++)
+        {
+            for (size_t lane = 0; lane < MAX_LANES; lane++)
+            {
+                m_Rows[i][lane] = m_Rows[i][lane] == (uint8_t)From ? (uint8_t)To : m_Rows[i][lane];
+            }
+        }
+    }
+    void Append(
+        const char Character
+    )
+    {
+        // Each lane writes to its own row so this one is done per lane
+        for (size_t lane = 0; lane < MAX_LANES; lane++)
+        {
+            if (m_Lengths[lane] < N)
+            {
+                m_Rows[m_Lengths[lane]++][lane] = Character;
+            }
+        }
+        m_RowsUsed = std::min(m_RowsUsed + 1, N);
+    }
+    void Prepend(
+        const char Character
+    )
+    {
+        // Every lane moves down a row together. The spare row
+        // catches the last byte of full lanes, which are put back
+        memmove(m_Rows[1].data(), m_Rows[0].data(), m_RowsUsed * MAX_LANES);
+        m_Rows[0].fill(Character);
+        for (size_t lane = 0; lane < MAX_LANES; lane++)
+        {
+            if (m_Lengths[lane] < N)
+            {
+                m_Lengths[lane]++;
+            }
+            else
+            {
+                for (size_t i = 0; i < N; i++)
+                {
+                    m_Rows[i][lane] = m_Rows[i + 1][lane];
+                }
+            }
+        }
+        m_RowsUsed = std::min(m_RowsUsed + 1, N);
+    }
+    void DeleteFirst(void)
+    {
+        if (m_RowsUsed == 0)
+        {
+            return;
+        }
+        memmove(m_Rows[0].data(), m_Rows[1].data(), (m_RowsUsed - 1) * MAX_LANES);
+        for (size_t lane = 0; lane < MAX_LANES; lane++)
+        {
+            m_Lengths[lane] -= m_Lengths[lane] > 0;
+        }
+        m_RowsUsed--;
+    }
+    void DeleteLast(void)
+    {
+        for (size_t lane = 0; lane < MAX_LANES; lane++)
+        {
+            m_Lengths[lane] -= m_Lengths[lane] > 0;
+        }
+    }
+    void Truncate(
+        const size_t Length
+    )
+    {
+        for (size_t lane = 0; lane < MAX_LANES; lane++)
+        {
+            m_Lengths[lane] = std::min(m_Lengths[lane], Length);
+        }
+        m_RowsUsed = std::min(m_RowsUsed, Length);
+    }
+private:
+    static inline uint8_t LowerByte(const uint8_t Byte) { return Byte | (((uint8_t)(Byte - 'A') < 26) << 5); }
+    static inline uint8_t UpperByte(const uint8_t Byte) { return Byte & ~(((uint8_t)(Byte - 'a') < 26) << 5); }
+    static inline uint8_t ToggleByte(const uint8_t Byte) { return Byte ^ (((uint8_t)((Byte | 0x20) - 'a') < 26) << 5); }
+    template <typename Fn>
+    void Transform(
+        const size_t First,
+        const size_t Last,
+        Fn&& Function
+    )
+    {
+        for (size_t i = First; i < Last; i++)
+        {
+            for (size_t lane = 0; lane < MAX_LANES; lane++)
+            {
+                m_Rows[i][lane] = Function(m_Rows[i][lane]);
+            }
+        }
+    }
+
+    // One spare row so prepending never drops a byte
+    std::array<std::array<uint8_t, MAX_LANES>, N + 1> m_Rows = {};
+    std::array<size_t, MAX_LANES> m_Lengths;
+    size_t m_RowsUsed = 0;
+};
+
+#endif /* TransposedBuffer_hpp */
@@ -20,6 +20,7 @@
 #include <optional>
 #include <string_view>
 #include <sys/mman.h>
+#include <unistd.h>
 #include <vector>
 
 #include "Check.hpp"
@@ -303,6 +304,21 @@ bool UnmapFileSpan(
     return result == 0;
 }
 
+// A wrapper around madvise for part of a mapped span. The range
+// is widened to whole pages as madvise requires page alignment
+template <typename T>
+inline static
+bool MadviseSpan(
+    std::span<T> Span,
+    const int Advice
+)
+{
+    static const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    const uintptr_t start = (uintptr_t)Span.data() & ~(pageSize - 1);
+    const uintptr_t end = (uintptr_t)Span.data() + Span.size_bytes();
+    return madvise((void*)start, end - start, Advice) == 0;
+}
+
 #pragma clang unsafe_buffer_usage end
 
 } // namespace cracktools
@@ -77,6 +77,23 @@ ToHex(
 	return oss.str();
 }
 
+void
+ToHex(
+	std::span<const uint8_t> Bytes,
+	std::string& Output
+)
+{
+	static const char kDigits[] = "0123456789abcdef";
+	const size_t offset = Output.size();
+	Output.resize(offset + Bytes.size() * 2);
+
+	for (size_t i = 0; i < Bytes.size(); i++)
+	{
+		Output[offset + i * 2] = kDigits[Bytes[i] >> 4];
+		Output[offset + i * 2 + 1] = kDigits[Bytes[i] & 0xf];
+	}
+}
+
 std::string
 ToHex(
 	const uint8_t* Bytes,
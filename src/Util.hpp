@@ -35,6 +35,14 @@ ToHex(
     std::span<const uint8_t> Bytes
 );
 
+// Appends to Output rather than building a new
+// string, for writing many hashes into one buffer
+void
+ToHex(
+    std::span<const uint8_t> Bytes,
+    std::string& Output
+);
+
 bool
 IsHex(
     const std::string_view String
@@ -7,13 +7,17 @@
 //
 
 #include <algorithm>
+#include <array>
 #include <cstdint>
 #include <iostream>
+#include <limits>
 #include <cmath>
+#include <cstring>
 #include <span>
 #include <ranges>
 #include <string>
 #include <string_view>
+#include <type_traits>
 #include <vector>
 #include <gmpxx.h>
 
@@ -401,6 +405,407 @@ WordGenerator::WordLengthIndex64(
     return index;
 }
 
+WordOdometer::WordOdometer(
+    std::string_view Charset,
+    std::string_view Prefix,
+    std::string_view Postfix
+) : m_Charset(Charset),
+    m_LookupTable(WordGenerator::GenerateParsingLookupTable(Charset)),
+    m_Offset(Prefix.size())
+{
+    m_Word = std::string(Prefix) + std::string(Postfix);
+    Seek(uint64_t(0));
+}
+
+void
+WordOdometer::SetWord(
+    std::string_view Word
+)
+{
+    const size_t postfix = m_Word.size() - m_Offset - m_Digits.size();
+    m_Word.replace(m_Offset, m_Word.size() - m_Offset - postfix, Word);
+    m_Digits.resize(Word.size());
+    for (size_t i = 0; i < Word.size(); i++)
+    {
+        m_Digits[i] = m_LookupTable[(uint8_t)Word[i]];
+    }
+}
+
+void
+WordOdometer::Seek(
+    const uint64_t Value
+)
+{
+    SetWord(WordGenerator::GenerateWord(Value, m_Charset));
+}
+
+void
+WordOdometer::Seek(
+    const unsigned __int128 Value
+)
+{
+    std::string word;
+    unsigned __int128 i = Value + 1;
+    const size_t charsetSize = m_Charset.size();
+
+    do
+    {
+        i--;
+        word += m_Charset[(size_t)(i % charsetSize)];
+        i /= charsetSize;
+    } while (i > 0);
+
+    SetWord(word);
+}
+
+void
+WordOdometer::Seek(
+    const mpz_class& Value
+)
+{
+    SetWord(WordGenerator::GenerateWord(Value, m_Charset));
+}
+
+const size_t
+WordOdometer::Next(
+    std::span<char> Destination
+)
+{
+    const size_t length = std::min(m_Word.size(), Destination.size());
+    memcpy(Destination.data(), m_Word.data(), length);
+
+    // The first character is the least significant digit
+    const size_t base = m_Charset.size();
+    for (size_t i = 0; i < m_Digits.size(); i++)
+    {
+        if (++m_Digits[i] < base)
+        {
+            m_Word[m_Offset + i] = m_Charset[m_Digits[i]];
+            return length;
+        }
+        m_Digits[i] = 0;
+        m_Word[m_Offset + i] = m_Charset[0];
+    }
+
+    // Every digit wrapped so the word grows by one
+    m_Word.insert(m_Offset + m_Digits.size(), 1, m_Charset[0]);
+    m_Digits.push_back(0);
+
+    return length;
+}
+
+/* static */ std::optional<std::string>
+Mask::ExpandCharset(
+    std::string_view Charset,
+    std::span<const std::string> Custom
+)
+{
+    std::string expanded;
+    for (size_t i = 0; i < Charset.size(); i++)
+    {
+        if (Charset[i] != '?')
+        {
+            expanded += Charset[i];
+            continue;
+        }
+
+        if (++i == Charset.size())
+        {
+            std::cerr << "Mask ends with an incomplete charset: " << Charset << std::endl;
+            return std::nullopt;
+        }
+
+        switch (Charset[i])
+        {
+        case 'l': expanded += LOWER; break;
+        case 'u': expanded += UPPER; break;
+        case 'd': expanded += NUMERIC; break;
+        case 'h': expanded += HEX_LOWER; break;
+        case 'H': expanded += HEX_UPPER; break;
+        case 's': expanded += ASCII_SPECIAL; break;
+        case 'a': expanded += LOWER + UPPER + NUMERIC + ASCII_SPECIAL; break;
+        case 'b':
+            for (size_t c = 0; c < 256; c++)
+            {
+                expanded += (char)c;
+            }
+            break;
+        case '?': expanded += '?'; break;
+        case '1':
+        case '2':
+        case '3':
+        case '4':
+        {
+            const size_t custom = Charset[i] - '1';
+            if (custom >= Custom.size() || Custom[custom].empty())
+            {
+                std::cerr << "Custom charset ?" << Charset[i] << " is not defined" << std::endl;
+                return std::nullopt;
+            }
+            expanded += Custom[custom];
+            break;
+        }
+        default:
+            std::cerr << "Unknown mask charset ?" << Charset[i] << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    // Repeated characters would generate the same words twice
+    std::string unique;
+    std::array<bool, 256> seen{};
+    for (const char c : expanded)
+    {
+        if (!seen[(uint8_t)c])
+        {
+            seen[(uint8_t)c] = true;
+            unique += c;
+        }
+    }
+    return unique;
+}
+
+/* static */ std::optional<Mask>
+Mask::Parse(
+    std::string_view Pattern,
+    std::span<const std::string> Custom
+)
+{
+    // Custom charsets may use the built in charsets
+    std::vector<std::string> custom;
+    for (const auto& charset : Custom)
+    {
+        auto expanded = ExpandCharset(charset);
+        if (!expanded.has_value())
+        {
+            return std::nullopt;
+        }
+        custom.push_back(std::move(*expanded));
+    }
+
+    Mask mask;
+    mask.m_Pattern = Pattern;
+    for (size_t i = 0; i < Pattern.size(); i++)
+    {
+        const size_t length = Pattern[i] == '?' ? 2 : 1;
+        auto charset = ExpandCharset(Pattern.substr(i, length), custom);
+        if (!charset.has_value())
+        {
+            return std::nullopt;
+        }
+        mask.m_Positions.push_back(std::move(*charset));
+        i += length - 1;
+    }
+
+    if (mask.m_Positions.empty())
+    {
+        std::cerr << "Empty mask" << std::endl;
+        return std::nullopt;
+    }
+
+    return mask;
+}
+
+/* static */ std::optional<Mask>
+Mask::ParseLine(
+    std::string_view Line,
+    std::span<const std::string> Custom
+)
+{
+    // Split on the commas which are not escaped as \,
+    std::vector<std::string> fields(1);
+    for (size_t i = 0; i < Line.size(); i++)
+    {
+        if (Line[i] == '\\' && i + 1 < Line.size() && Line[i + 1] == ',')
+        {
+            fields.back() += Line[++i];
+        }
+        else if (Line[i] == ',')
+        {
+            fields.emplace_back();
+        }
+        else
+        {
+            fields.back() += Line[i];
+        }
+    }
+
+    if (fields.size() > 5)
+    {
+        std::cerr << "Too many custom charsets in mask line: " << Line << std::endl;
+        return std::nullopt;
+    }
+
+    std::vector<std::string> custom(Custom.begin(), Custom.end());
+    custom.resize(std::max<size_t>(custom.size(), fields.size() - 1));
+    for (size_t i = 0; i < fields.size() - 1; i++)
+    {
+        custom[i] = fields[i];
+    }
+
+    return Parse(fields.back(), custom);
+}
+
+const mpz_class
+Mask::Keyspace(
+    const size_t Length
+) const
+{
+    mpz_class keyspace = 1;
+    for (size_t i = 0; i < Length && i < m_Positions.size(); i++)
+    {
+        keyspace *= m_Positions[i].size();
+    }
+    return keyspace;
+}
+
+const mpz_class
+Mask::LengthIndex(
+    const size_t Length
+) const
+{
+    mpz_class index = 0;
+    for (size_t i = 1; i < Length; i++)
+    {
+        index += Keyspace(i);
+    }
+    return index;
+}
+
+std::optional<mpz_class>
+Mask::Index(
+    std::string_view Word
+) const
+{
+    if (Word.empty() || Word.size() > m_Positions.size())
+    {
+        return std::nullopt;
+    }
+
+    mpz_class index = 0;
+    for (size_t i = Word.size(); i-- > 0;)
+    {
+        const size_t digit = m_Positions[i].find(Word[i]);
+        if (digit == std::string::npos)
+        {
+            return std::nullopt;
+        }
+        index = index * m_Positions[i].size() + digit;
+    }
+    return LengthIndex(Word.size()) + index;
+}
+
+MaskOdometer::MaskOdometer(
+    const Mask& Mask,
+    std::string_view Prefix,
+    std::string_view Postfix
+) : m_Mask(Mask),
+    m_Offset(Prefix.size())
+{
+    m_Word = std::string(Prefix) + std::string(Postfix);
+    Seek(uint64_t(0));
+}
+
+template <typename T>
+void
+MaskOdometer::SeekIndex(
+    T Value
+)
+{
+    // Find the length of the word by skipping the shorter ones
+    size_t length = 1;
+    T count = m_Mask.GetCharset(0).size();
+    while (length < m_Mask.GetLength() && Value >= count)
+    {
+        Value -= count;
+        const size_t radix = m_Mask.GetCharset(length).size();
+        if constexpr (!std::is_same_v<T, mpz_class>)
+        {
+            // The value is already below a count too big to hold
+            if (count > std::numeric_limits<T>::max() / radix)
+            {
+                length++;
+                break;
+            }
+        }
+        count *= radix;
+        length++;
+    }
+
+    m_Word.erase(m_Offset, m_Digits.size());
+    m_Digits.resize(length);
+    std::string word(length, ' ');
+    for (size_t i = 0; i < length; i++)
+    {
+        const size_t radix = m_Mask.GetCharset(i).size();
+        if constexpr (std::is_same_v<T, mpz_class>)
+        {
+            m_Digits[i] = mpz_fdiv_q_ui(Value.get_mpz_t(), Value.get_mpz_t(), radix);
+        }
+        else
+        {
+            m_Digits[i] = (size_t)(Value % radix);
+            Value /= radix;
+        }
+        word[i] = m_Mask.GetCharset(i)[m_Digits[i]];
+    }
+    m_Word.insert(m_Offset, word);
+}
+
+void
+MaskOdometer::Seek(
+    const uint64_t Value
+)
+{
+    SeekIndex(Value);
+}
+
+void
+MaskOdometer::Seek(
+    const unsigned __int128 Value
+)
+{
+    SeekIndex(Value);
+}
+
+void
+MaskOdometer::Seek(
+    const mpz_class& Value
+)
+{
+    SeekIndex(Value);
+}
+
+const size_t
+MaskOdometer::Next(
+    std::span<char> Destination
+)
+{
+    const size_t length = std::min(m_Word.size(), Destination.size());
+    memcpy(Destination.data(), m_Word.data(), length);
+
+    for (size_t i = 0; i < m_Digits.size(); i++)
+    {
+        const std::string_view charset = m_Mask.GetCharset(i);
+        if (++m_Digits[i] < charset.size())
+        {
+            m_Word[m_Offset + i] = charset[m_Digits[i]];
+            return length;
+        }
+        m_Digits[i] = 0;
+        m_Word[m_Offset + i] = charset[0];
+    }
+
+    // Every digit wrapped so move to the next length
+    if (m_Digits.size() < m_Mask.GetLength())
+    {
+        m_Word.insert(m_Offset + m_Digits.size(), 1, m_Mask.GetCharset(m_Digits.size())[0]);
+        m_Digits.push_back(0);
+    }
+
+    return length;
+}
+
 const std::string_view
 ParseCharset(
     std::string_view Name
@@ -10,6 +10,7 @@
 #define WordGenerator_hpp
 
 #include <cstdint>
+#include <optional>
 #include <span>
 #include <string>
 #include <string_view>
@@ -33,6 +34,9 @@ static const std::string ASCII = ASCII_SPECIAL_LO + NUMERIC + ASCII_SPECIAL_ML +
 // Based on an analysis of cracked passwords
 static const std::string COMMON = "a1e20ion9r3sl85746tumdychbkgfpvjwzxqAE._SRMNILTODCBKPHG-UF!YJVWZ@QX*$#?& :+/";
 static const std::string COMMON_SHORT = "a1e20ion9r3sl85746tumdychbkgfpvjwzxqAE._SRMNILTODCBKPHG-UF!YJVWZ@QX";
+// The hashcat mask charsets which aren't above
+static const std::string HEX_LOWER = "0123456789abcdef";
+static const std::string HEX_UPPER = "0123456789ABCDEF";
 
 class WordGenerator
 {
@@ -87,6 +91,82 @@ private:
     std::vector<uint8_t> m_LookupTable;
 };
 
+// Steps through the words of a charset in index order, carrying from
+// digit to digit like an odometer. After a single Seek each word costs
+// amortized O(1) with no division, bignum arithmetic or allocation.
+// The word is held between the prefix and postfix ready to be copied
+// straight into a hash buffer
+class WordOdometer
+{
+public:
+    WordOdometer(std::string_view Charset, std::string_view Prefix = "", std::string_view Postfix = "");
+    void Seek(const uint64_t Value);
+    void Seek(const unsigned __int128 Value);
+    void Seek(const mpz_class& Value);
+    // Writes the current word to the destination and moves to the next.
+    // Returns the length written, words are cut short to fit
+    const size_t Next(std::span<char> Destination);
+    const std::string_view Get(void) const { return m_Word; }
+private:
+    void SetWord(std::string_view Word);
+
+    std::string_view m_Charset;
+    std::vector<uint8_t> m_LookupTable;
+    size_t m_Offset;
+    std::string m_Word;
+    std::vector<size_t> m_Digits;
+};
+
+// A hashcat style mask giving the charset of each position of a word,
+// such as ?u?l?l?l?d?d?s. Supports the built in charsets ?l ?u ?d ?h ?H
+// ?s ?a ?b, the custom charsets ?1 to ?4, literal characters and ?? for
+// a literal question mark. Words are indexed from the shortest, with the
+// first position the least significant, so increment mode is the index
+// range covering a number of lengths
+class Mask
+{
+public:
+    static std::optional<Mask> Parse(std::string_view Pattern, std::span<const std::string> Custom = {});
+    static std::optional<std::string> ExpandCharset(std::string_view Charset, std::span<const std::string> Custom = {});
+    // Parses a line of a hashcat .hcmask file. The mask may be preceded by
+    // up to four comma separated charsets which replace the custom ones
+    static std::optional<Mask> ParseLine(std::string_view Line, std::span<const std::string> Custom = {});
+    const std::string& GetPattern(void) const { return m_Pattern; }
+    const size_t GetLength(void) const { return m_Positions.size(); }
+    std::string_view GetCharset(const size_t Position) const { return m_Positions[Position]; }
+    // The number of words using the first Length positions
+    const mpz_class Keyspace(const size_t Length) const;
+    // The index of the first word with Length positions
+    const mpz_class LengthIndex(const size_t Length) const;
+    std::optional<mpz_class> Index(std::string_view Word) const;
+private:
+    std::string m_Pattern;
+    std::vector<std::string> m_Positions;
+};
+
+// Steps through the words of a mask like WordOdometer, with each position
+// carrying at its own radix. The mask must outlive the odometer
+class MaskOdometer
+{
+public:
+    MaskOdometer(const Mask& Mask, std::string_view Prefix = "", std::string_view Postfix = "");
+    void Seek(const uint64_t Value);
+    void Seek(const unsigned __int128 Value);
+    void Seek(const mpz_class& Value);
+    // Writes the current word to the destination and moves to the next.
+    // Returns the length written, words are cut short to fit
+    const size_t Next(std::span<char> Destination);
+    const std::string_view Get(void) const { return m_Word; }
+private:
+    template <typename T>
+    void SeekIndex(T Value);
+
+    const Mask& m_Mask;
+    size_t m_Offset;
+    std::string m_Word;
+    std::vector<size_t> m_Digits;
+};
+
 const std::string_view
 ParseCharset(
     const std::string_view Name
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "BlockQueue.hpp"
+
+TEST(BlockQueue, Order) {
+    BlockQueue<int> queue(4);
+    EXPECT_TRUE(queue.Push(1));
+    EXPECT_TRUE(queue.Push(2));
+    int item;
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 1);
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 2);
+    EXPECT_FALSE(queue.TryPop(item));
+}
+
+TEST(BlockQueue, Bounded) {
+    BlockQueue<int> queue(2);
+    EXPECT_TRUE(queue.TryPush(1));
+    EXPECT_TRUE(queue.TryPush(2));
+    EXPECT_FALSE(queue.TryPush(3));
+    int item;
+    EXPECT_TRUE(queue.TryPop(item));
+    EXPECT_TRUE(queue.TryPush(3));
+}
+
+TEST(BlockQueue, CloseDrains) {
+    BlockQueue<int> queue(4);
+    queue.Push(1);
+    queue.Close();
+    EXPECT_TRUE(queue.IsClosed());
+    EXPECT_FALSE(queue.Push(2));
+    int item;
+    EXPECT_TRUE(queue.Pop(item));
+    EXPECT_EQ(item, 1);
+    EXPECT_FALSE(queue.Pop(item));
+}
+
+TEST(BlockQueue, CloseWakes) {
+    // A consumer waiting on an empty queue and a producer
+    // waiting on a full one both return once it is closed
+    BlockQueue<int> empty(1);
+    BlockQueue<int> full(1);
+    full.Push(0);
+    std::atomic<int> woken = 0;
+    std::thread consumer([&]{ int item; EXPECT_FALSE(empty.Pop(item)); woken++; });
+    std::thread producer([&]{ EXPECT_FALSE(full.Push(1)); woken++; });
+    empty.Close();
+    full.Close();
+    consumer.join();
+    producer.join();
+    EXPECT_EQ(woken, 2);
+}
+
+TEST(BlockQueue, ManyProducersConsumers) {
+    constexpr size_t kProducers = 4;
+    constexpr size_t kConsumers = 4;
+    constexpr size_t kItems = 20000;
+    BlockQueue<size_t> queue(16);
+    std::atomic<size_t> sum = 0;
+    std::atomic<size_t> count = 0;
+
+    std::vector<std::thread> consumers;
+    for (size_t c = 0; c < kConsumers; c++) {
+        consumers.emplace_back([&]{
+            size_t item;
+            while (queue.Pop(item)) {
+                sum += item;
+                count++;
+            }
+        });
+    }
+
+    std::vector<std::thread> producers;
+    for (size_t p = 0; p < kProducers; p++) {
+        producers.emplace_back([&, p]{
+            for (size_t i = 0; i < kItems; i++) {
+                EXPECT_TRUE(queue.Push(p * kItems + i));
+            }
+        });
+    }
+
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    queue.Close();
+    for (auto& consumer : consumers) {
+        consumer.join();
+    }
+
+    const size_t total = kProducers * kItems;
+    EXPECT_EQ(count, total);
+    EXPECT_EQ(sum, total * (total - 1) / 2);
+}
@@ -0,0 +1,229 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "CompressedStream.hpp"
+
+static std::string
+GenerateWords(
+    const size_t Count
+)
+{
+    std::string words;
+    for (size_t i = 0; i < Count; i++) {
+        words += "word" + std::to_string(i * 7919) + "\n";
+    }
+    return words;
+}
+
+static std::filesystem::path
+TempPath(
+    const std::string& Name
+)
+{
+    return std::filesystem::temp_directory_path() / ("compressedstream_" + Name);
+}
+
+static void
+WriteGzip(
+    const std::filesystem::path& Path,
+    const std::vector<std::string>& Members
+)
+{
+    // Each gzopen writes its own member, appending
+    // them as pigz and cat do
+    std::filesystem::remove(Path);
+    for (const auto& member : Members) {
+        gzFile file = gzopen(Path.c_str(), "ab");
+        ASSERT_NE(file, nullptr);
+        ASSERT_EQ(gzwrite(file, member.data(), member.size()), (int)member.size());
+        gzclose(file);
+    }
+}
+
+static std::string
+ReadAll(
+    const std::filesystem::path& Path
+)
+{
+    CompressedStream stream;
+    EXPECT_TRUE(stream.Open(Path));
+    std::string data;
+    for (std::string line; std::getline(stream, line); ) {
+        data += line + "\n";
+    }
+    return data;
+}
+
+TEST(CompressedStream, Detect) {
+    const auto path = TempPath("plain.txt");
+    std::ofstream(path) << "password\n";
+    EXPECT_EQ(CompressedStream::Detect(path), CompressionNone);
+    EXPECT_EQ(CompressedStream::Detect(TempPath("missing")), CompressionNone);
+
+    WriteGzip(TempPath("detect.gz"), {"password\n"});
+    EXPECT_EQ(CompressedStream::Detect(TempPath("detect.gz")), CompressionGzip);
+
+    CompressedStream stream;
+    EXPECT_FALSE(stream.Open(path));
+    std::filesystem::remove(path);
+    std::filesystem::remove(TempPath("detect.gz"));
+}
+
+TEST(CompressedStream, Gzip) {
+    // Larger than several decompressed blocks
+    const std::string words = GenerateWords(400000);
+    const auto path = TempPath("words.gz");
+    WriteGzip(path, {words});
+    EXPECT_EQ(ReadAll(path), words);
+
+    CompressedStream stream;
+    ASSERT_TRUE(stream.Open(path));
+    for (std::string line; std::getline(stream, line); ) {}
+    EXPECT_FALSE(stream.Failed());
+    std::filesystem::remove(path);
+}
+
+TEST(CompressedStream, GzipMembers) {
+    const std::vector<std::string> members = {GenerateWords(1000), "", GenerateWords(50000)};
+    const auto path = TempPath("members.gz");
+    WriteGzip(path, members);
+    EXPECT_EQ(ReadAll(path), members[0] + members[1] + members[2]);
+    std::filesystem::remove(path);
+}
+
+TEST(CompressedStream, GzipTruncated) {
+    // A cut short file ends the stream and is reported as a failure
+    const auto path = TempPath("truncated.gz");
+    WriteGzip(path, {GenerateWords(400000)});
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+
+    CompressedStream stream;
+    ASSERT_TRUE(stream.Open(path));
+    for (std::string line; std::getline(stream, line); ) {}
+    EXPECT_TRUE(stream.Failed());
+    std::filesystem::remove(path);
+}
+
+TEST(CompressedStream, CloseEarly) {
+    // Closing before the end stops the decompressor
+    const auto path = TempPath("early.gz");
+    WriteGzip(path, {GenerateWords(400000)});
+    {
+        CompressedStream stream;
+        ASSERT_TRUE(stream.Open(path));
+        std::string line;
+        std::getline(stream, line);
+        EXPECT_EQ(line, "word0");
+    }
+    std::filesystem::remove(path);
+}
+
+#ifdef HAVE_LZMA
+TEST(CompressedStream, Xz) {
+    const std::string words = GenerateWords(200000);
+    std::vector<uint8_t> compressed(lzma_stream_buffer_bound(words.size()));
+    size_t length = 0;
+    ASSERT_EQ(lzma_easy_buffer_encode(1, LZMA_CHECK_CRC64, nullptr,
+        (const uint8_t*)words.data(), words.size(), compressed.data(), &length, compressed.size()), LZMA_OK);
+
+    const auto path = TempPath("words.xz");
+    std::ofstream(path, std::ios::binary).write((const char*)compressed.data(), length);
+    EXPECT_EQ(CompressedStream::Detect(path), CompressionXz);
+    EXPECT_EQ(ReadAll(path), words);
+    std::filesystem::remove(path);
+}
+#endif
+
+#ifdef HAVE_ZSTD
+static void
+WriteZstd(
+    const std::filesystem::path& Path,
+    const std::vector<std::string>& Frames,
+    const bool ContentSize = true
+)
+{
+    // Each frame is compressed on its own and appended, as pzstd does
+    ZSTD_CCtx* context = ZSTD_createCCtx();
+    ZSTD_CCtx_setParameter(context, ZSTD_c_contentSizeFlag, ContentSize);
+    std::ofstream file(Path, std::ios::binary);
+    for (const auto& frame : Frames) {
+        std::vector<char> compressed(ZSTD_compressBound(frame.size()));
+        const size_t length = ZSTD_compress2(context, compressed.data(), compressed.size(), frame.data(), frame.size());
+        ASSERT_FALSE(ZSTD_isError(length));
+        file.write(compressed.data(), length);
+    }
+    ZSTD_freeCCtx(context);
+}
+
+TEST(CompressedStream, Zstd) {
+    const std::string words = GenerateWords(200000);
+    const auto path = TempPath("words.zst");
+    WriteZstd(path, {words});
+    EXPECT_EQ(CompressedStream::Detect(path), CompressionZstd);
+    EXPECT_EQ(ReadAll(path), words);
+
+    // Frames without a content size are streamed
+    WriteZstd(path, {words}, false);
+    EXPECT_EQ(ReadAll(path), words);
+    std::filesystem::remove(path);
+}
+
+TEST(CompressedStream, ZstdFrames) {
+    // More frames than are decompressed at once, so they
+    // finish out of order and must be emitted in order
+    std::vector<std::string> frames;
+    std::string words;
+    for (size_t i = 0; i < 32; i++) {
+        frames.push_back(GenerateWords(1000 + i * 997));
+        words += frames.back();
+    }
+    frames.push_back("");
+    const auto path = TempPath("frames.zst");
+    WriteZstd(path, frames);
+
+    CompressedStream stream;
+    ASSERT_TRUE(stream.Open(path));
+    std::string data;
+    for (std::string line; std::getline(stream, line); ) {
+        data += line + "\n";
+    }
+    EXPECT_EQ(data, words);
+    EXPECT_FALSE(stream.Failed());
+
+    // Frames of unknown size between them are streamed in place
+    const auto unsized = TempPath("unsized.zst");
+    WriteZstd(unsized, {GenerateWords(5000)}, false);
+    std::ofstream(path, std::ios::binary | std::ios::app) << std::ifstream(unsized, std::ios::binary).rdbuf();
+    WriteZstd(unsized, {"last\n"});
+    std::ofstream(path, std::ios::binary | std::ios::app) << std::ifstream(unsized, std::ios::binary).rdbuf();
+    EXPECT_EQ(ReadAll(path), words + GenerateWords(5000) + "last\n");
+    std::filesystem::remove(path);
+    std::filesystem::remove(unsized);
+}
+
+TEST(CompressedStream, ZstdTruncated) {
+    const auto path = TempPath("truncated.zst");
+    for (const bool contentSize : {true, false}) {
+        WriteZstd(path, {GenerateWords(50000), GenerateWords(50000)}, contentSize);
+        std::filesystem::resize_file(path, std::filesystem::file_size(path) - 100);
+
+        CompressedStream stream;
+        ASSERT_TRUE(stream.Open(path));
+        for (std::string line; std::getline(stream, line); ) {}
+        EXPECT_TRUE(stream.Failed());
+    }
+    std::filesystem::remove(path);
+}
+#endif
@@ -0,0 +1,87 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "DeltaEncoding.hpp"
+
+TEST(DeltaEncoding, VarintRoundTrip) {
+    const std::vector<uint64_t> values = {
+        0, 1, 0x7f, 0x80, 0x3fff, 0x4000, 0xffffffff, UINT64_MAX
+    };
+    for (const uint64_t value : values) {
+        std::vector<uint8_t> buffer;
+        cracktools::VarintAppend(value, buffer);
+        uint64_t decoded = 0;
+        EXPECT_EQ(cracktools::VarintDecode(buffer, decoded), buffer.size());
+        EXPECT_EQ(decoded, value);
+    }
+}
+
+TEST(DeltaEncoding, VarintLengths) {
+    std::vector<uint8_t> buffer;
+    cracktools::VarintAppend(0x7f, buffer);
+    EXPECT_EQ(buffer.size(), 1);
+    buffer.clear();
+    cracktools::VarintAppend(0x80, buffer);
+    EXPECT_EQ(buffer.size(), 2);
+    buffer.clear();
+    cracktools::VarintAppend(UINT64_MAX, buffer);
+    EXPECT_EQ(buffer.size(), cracktools::kVarintMaxLength);
+}
+
+TEST(DeltaEncoding, VarintTruncated) {
+    std::vector<uint8_t> buffer;
+    cracktools::VarintAppend(0x4000, buffer);
+    buffer.pop_back();
+    uint64_t decoded = 0;
+    EXPECT_EQ(cracktools::VarintDecode(buffer, decoded), 0);
+}
+
+TEST(DeltaEncoding, BitsRequired) {
+    EXPECT_EQ(cracktools::BitsRequired(0), 1);
+    EXPECT_EQ(cracktools::BitsRequired(1), 1);
+    EXPECT_EQ(cracktools::BitsRequired(255), 8);
+    EXPECT_EQ(cracktools::BitsRequired(256), 9);
+    EXPECT_EQ(cracktools::BitsRequired(UINT64_MAX), 64);
+}
+
+TEST(DeltaEncoding, BitPackedRoundTrip) {
+    std::mt19937_64 random(1234);
+    for (const size_t bits : {1, 7, 13, 31, 32, 33, 63, 64}) {
+        const uint64_t mask = bits == 64 ? UINT64_MAX : (1ull << bits) - 1;
+        std::vector<uint64_t> values(1000);
+        cracktools::BitPackedWriter writer(bits);
+        for (auto& value : values) {
+            value = random() & mask;
+            writer.Push(value);
+        }
+        auto words = writer.GetWords();
+        EXPECT_EQ(words.size(), cracktools::BitPackedWords(values.size(), bits));
+        for (size_t i = 0; i < values.size(); i++) {
+            EXPECT_EQ(cracktools::BitPackedGet(words, bits, i), values[i]);
+        }
+    }
+}
+
+TEST(DeltaEncoding, DeltaBlockReader) {
+    const std::vector<uint64_t> values = { 100, 100, 101, 300, 70000, 70000, 1ull << 40 };
+    std::vector<uint8_t> data;
+    for (size_t i = 1; i < values.size(); i++) {
+        cracktools::VarintAppend(values[i] - values[i - 1], data);
+    }
+
+    cracktools::DeltaBlockReader reader(values[0], data, values.size());
+    std::vector<uint64_t> decoded = { reader.Value() };
+    while (reader.Next()) {
+        decoded.push_back(reader.Value());
+    }
+    EXPECT_EQ(decoded, values);
+}
+
+TEST(DeltaEncoding, DeltaBlockReaderSingle) {
+    cracktools::DeltaBlockReader reader(42, {}, 1);
+    EXPECT_EQ(reader.Value(), 42);
+    EXPECT_FALSE(reader.Next());
+}
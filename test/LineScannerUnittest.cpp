@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "LineScanner.hpp"
+
+static std::vector<uint32_t>
+FindNewlinesSlow(
+    std::string_view Data
+)
+{
+    std::vector<uint32_t> newlines;
+    for (size_t i = 0; i < Data.size(); i++) {
+        if (Data[i] == '\n') {
+            newlines.push_back(i);
+        }
+    }
+    return newlines;
+}
+
+TEST(LineScanner, Empty) {
+    std::vector<uint32_t> newlines;
+    LineScanner::FindNewlines("", newlines);
+    EXPECT_TRUE(newlines.empty());
+    LineScanner::FindNewlines("no newline here", newlines);
+    EXPECT_TRUE(newlines.empty());
+}
+
+TEST(LineScanner, Lines) {
+    std::vector<uint32_t> newlines;
+    LineScanner::FindNewlines("abc\r\nde\n\nf", newlines);
+    EXPECT_EQ(newlines, std::vector<uint32_t>({4, 7, 8}));
+}
+
+TEST(LineScanner, Appends) {
+    std::vector<uint32_t> newlines = {99};
+    LineScanner::FindNewlines("\n", newlines);
+    EXPECT_EQ(newlines, std::vector<uint32_t>({99, 0}));
+}
+
+TEST(LineScanner, MatchesSlow) {
+    // Bytes next to the newline, such as 0x0b and 0x8a, must not
+    // be mistaken for it by the eight byte at a time search
+    const std::string alphabet = std::string("ab\n\r\x0b\x09\x8a\x00\xff", 9);
+    std::mt19937 rng(1234);
+    for (size_t length = 0; length < 300; length++) {
+        std::string data;
+        for (size_t i = 0; i < length + 7; i++) {
+            data.push_back(alphabet[rng() % alphabet.size()]);
+        }
+        // Every starting alignment
+        for (size_t offset = 0; offset < 8; offset++) {
+            std::string_view view(data.data() + offset, length);
+            std::vector<uint32_t> newlines;
+            LineScanner::FindNewlines(view, newlines);
+            EXPECT_EQ(newlines, FindNewlinesSlow(view)) << length << " " << offset;
+        }
+    }
+}
+
+TEST(LineScanner, AllNewlines) {
+    const std::string data(257, '\n');
+    std::vector<uint32_t> newlines;
+    LineScanner::FindNewlines(data, newlines);
+    EXPECT_EQ(newlines, FindNewlinesSlow(data));
+}
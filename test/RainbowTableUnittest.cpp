@@ -0,0 +1,72 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <string>
+
+#include "RainbowTable.hpp"
+
+static std::filesystem::path
+TempPath(
+    const std::string& Name
+)
+{
+    return std::filesystem::temp_directory_path() / ("rainbowtable_" + Name);
+}
+
+static void
+RemoveTable(
+    const std::filesystem::path& Path
+)
+{
+    std::filesystem::remove(Path);
+    std::filesystem::remove(std::filesystem::path(Path).concat(".idx"));
+}
+
+// Perfect tables drop merged chains, so their startpoints are no longer
+// the chain indexes a compressed table stores them as
+TEST(RainbowTable, PerfectTableWontCompress) {
+    const auto perfectPath = TempPath("perfect.utbl");
+    const auto deltaPath = TempPath("perfect.dtbl");
+    const auto compressedPath = TempPath("perfect.rt");
+    RemoveTable(perfectPath);
+    RemoveTable(deltaPath);
+    RemoveTable(compressedPath);
+
+    {
+        RainbowTable build;
+        build.SetPath(perfectPath);
+        build.SetAlgorithm("md5");
+        build.SetMin(1);
+        build.SetMax(3);
+        build.SetCharset("lower");
+        build.SetLength(100);
+        build.SetCount(4096);
+        build.SetThreads(1);
+        build.SetType(TypeUncompressed);
+        build.SetSortedBuild(true);
+        build.SetPerfect(true);
+        ASSERT_TRUE(build.InitAndRunBuild());
+    }
+
+    RainbowTable perfect;
+    perfect.SetPath(perfectPath);
+    ASSERT_TRUE(perfect.ValidTable());
+    ASSERT_TRUE(perfect.LoadTable());
+    ASSERT_LT(perfect.GetCount(), 4096);
+
+    EXPECT_FALSE(perfect.Compress(compressedPath));
+    EXPECT_FALSE(std::filesystem::exists(compressedPath));
+
+    // Delta tables keep the startpoints of the chains they hold
+    ASSERT_TRUE(perfect.DeltaEncode(deltaPath));
+    RainbowTable delta;
+    delta.SetPath(deltaPath);
+    ASSERT_TRUE(delta.LoadTable());
+    EXPECT_EQ(delta.GetCount(), perfect.GetCount());
+
+    EXPECT_FALSE(delta.Compress(compressedPath));
+    EXPECT_FALSE(std::filesystem::exists(compressedPath));
+
+    RemoveTable(perfectPath);
+    RemoveTable(deltaPath);
+}
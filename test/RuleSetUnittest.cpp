@@ -0,0 +1,165 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "RuleSet.hpp"
+#include "TransposedBuffer.hpp"
+
+static std::string
+ApplyRule(
+    const std::string& Rule,
+    const std::string& Word,
+    const size_t Capacity = 64
+)
+{
+    RuleSet rules;
+    EXPECT_TRUE(rules.AddRule(Rule)) << Rule;
+    std::string buffer(Capacity, '\0');
+    const size_t length = rules.Apply(0, Word, buffer);
+    if (length == RuleSet::kRejected) {
+        return "<rejected>";
+    }
+    return buffer.substr(0, length);
+}
+
+TEST(RuleSet, Case) {
+    EXPECT_EQ(ApplyRule(":", "p@ssW0rd"), "p@ssW0rd");
+    EXPECT_EQ(ApplyRule("l", "p@ssW0rd"), "p@ssw0rd");
+    EXPECT_EQ(ApplyRule("u", "p@ssW0rd"), "P@SSW0RD");
+    EXPECT_EQ(ApplyRule("c", "p@ssW0rd"), "P@ssw0rd");
+    EXPECT_EQ(ApplyRule("C", "p@ssW0rd"), "p@SSW0RD");
+    EXPECT_EQ(ApplyRule("t", "p@ssW0rd"), "P@SSw0RD");
+    EXPECT_EQ(ApplyRule("T3", "p@ssW0rd"), "p@sSW0rd");
+    EXPECT_EQ(ApplyRule("E", "hello WORLD"), "Hello World");
+    EXPECT_EQ(ApplyRule("e-", "hello-WORLD"), "Hello-World");
+    EXPECT_EQ(ApplyRule("30-", "pass-word-x"), "pass-Word-x");
+}
+
+TEST(RuleSet, Reorder) {
+    EXPECT_EQ(ApplyRule("r", "p@ssW0rd"), "dr0Wss@p");
+    EXPECT_EQ(ApplyRule("d", "abc"), "abcabc");
+    EXPECT_EQ(ApplyRule("p2", "abc"), "abcabcabc");
+    EXPECT_EQ(ApplyRule("f", "abc"), "abccba");
+    EXPECT_EQ(ApplyRule("{", "abc"), "bca");
+    EXPECT_EQ(ApplyRule("}", "abc"), "cab");
+    EXPECT_EQ(ApplyRule("k", "abc"), "bac");
+    EXPECT_EQ(ApplyRule("K", "abc"), "acb");
+    EXPECT_EQ(ApplyRule("*02", "abc"), "cba");
+    EXPECT_EQ(ApplyRule("q", "abc"), "aabbcc");
+}
+
+TEST(RuleSet, InsertDelete) {
+    EXPECT_EQ(ApplyRule("$1 $2", "abc"), "abc12");
+    EXPECT_EQ(ApplyRule("^1^2", "abc"), "21abc");
+    EXPECT_EQ(ApplyRule("[", "abc"), "bc");
+    EXPECT_EQ(ApplyRule("]", "abc"), "ab");
+    EXPECT_EQ(ApplyRule("D1", "abc"), "ac");
+    EXPECT_EQ(ApplyRule("x13", "abcdef"), "bcd");
+    EXPECT_EQ(ApplyRule("O12", "abcdef"), "adef");
+    EXPECT_EQ(ApplyRule("i1!", "abc"), "a!bc");
+    EXPECT_EQ(ApplyRule("i3!", "abc"), "abc!");
+    EXPECT_EQ(ApplyRule("o1!", "abc"), "a!c");
+    EXPECT_EQ(ApplyRule("'2", "abc"), "ab");
+    EXPECT_EQ(ApplyRule("ss$", "pass"), "pa$$");
+    EXPECT_EQ(ApplyRule("@s", "pass"), "pa");
+    EXPECT_EQ(ApplyRule("z2", "abc"), "aaabc");
+    EXPECT_EQ(ApplyRule("Z2", "abc"), "abccc");
+    EXPECT_EQ(ApplyRule("y2", "abc"), "ababc");
+    EXPECT_EQ(ApplyRule("Y2", "abc"), "abcbc");
+    // Out of range positions leave the word alone
+    EXPECT_EQ(ApplyRule("D5", "abc"), "abc");
+    EXPECT_EQ(ApplyRule("x24", "abc"), "abc");
+    EXPECT_EQ(ApplyRule("TA", "abc"), "abc");
+}
+
+TEST(RuleSet, Characters) {
+    EXPECT_EQ(ApplyRule("L0", "a"), std::string(1, 'a' << 1));
+    EXPECT_EQ(ApplyRule("R0", "b"), std::string(1, 'b' >> 1));
+    EXPECT_EQ(ApplyRule("+0-1", "bb"), "ca");
+    EXPECT_EQ(ApplyRule(".0", "abc"), "bbc");
+    EXPECT_EQ(ApplyRule(",1", "abc"), "aac");
+}
+
+TEST(RuleSet, Memory) {
+    EXPECT_EQ(ApplyRule("u4", "abc"), "ABCabc");
+    EXPECT_EQ(ApplyRule("u6", "abc"), "abcABC");
+    EXPECT_EQ(ApplyRule("uM$14", "abc"), "ABC1ABC");
+    EXPECT_EQ(ApplyRule("uX021", "abc"), "AabBC");
+    EXPECT_EQ(ApplyRule("lQ", "abc"), "<rejected>");
+    EXPECT_EQ(ApplyRule("uQ", "abc"), "ABC");
+}
+
+TEST(RuleSet, Reject) {
+    EXPECT_EQ(ApplyRule("<3", "abcd"), "<rejected>");
+    EXPECT_EQ(ApplyRule("<4", "abcd"), "abcd");
+    EXPECT_EQ(ApplyRule(">5", "abcd"), "<rejected>");
+    EXPECT_EQ(ApplyRule("_4", "abcd"), "abcd");
+    EXPECT_EQ(ApplyRule("_3", "abcd"), "<rejected>");
+    EXPECT_EQ(ApplyRule("!b", "abcd"), "<rejected>");
+    EXPECT_EQ(ApplyRule("/z", "abcd"), "<rejected>");
+    EXPECT_EQ(ApplyRule("(a", "abcd"), "abcd");
+    EXPECT_EQ(ApplyRule(")a", "abcd"), "<rejected>");
+    EXPECT_EQ(ApplyRule("=1b", "abcd"), "abcd");
+    EXPECT_EQ(ApplyRule("=1c", "abcd"), "<rejected>");
+    EXPECT_EQ(ApplyRule("%2s", "pass"), "pass");
+    EXPECT_EQ(ApplyRule("%3s", "pass"), "<rejected>");
+}
+
+TEST(RuleSet, Capacity) {
+    // Growing past the destination leaves the word as it was
+    EXPECT_EQ(ApplyRule("d", "abc", 5), "abc");
+    EXPECT_EQ(ApplyRule("$1$2$3", "abc", 5), "abc12");
+    EXPECT_EQ(ApplyRule("^1", "abcde", 5), "abcde");
+}
+
+TEST(RuleSet, Invalid) {
+    RuleSet rules;
+    EXPECT_FALSE(rules.AddRule("$"));
+    EXPECT_FALSE(rules.AddRule("T!"));
+    EXPECT_FALSE(rules.AddRule("w"));
+    EXPECT_TRUE(rules.AddRule("$ "));
+    EXPECT_TRUE(rules.AddRule(""));
+    EXPECT_EQ(rules.GetCount(), 2);
+
+    std::string buffer(16, '\0');
+    EXPECT_EQ(rules.Apply(0, "abc", buffer), 4);
+    EXPECT_EQ(buffer.substr(0, 4), "abc ");
+    EXPECT_EQ(rules.Apply(1, "abc", buffer), 3);
+}
+
+TEST(RuleSet, LanesMatchScalar) {
+    const std::vector<std::string> words = {
+        "password", "", "Hello World", "a", "MiXeD123", "zzzzzzzzzzzzzzzz", "@dmin", "x"
+    };
+    const std::vector<std::string> rules = {
+        ":", "l", "u", "c", "C", "t", "T0", "T5", "$1", "$1$2$3", "^!", "^a^b",
+        "[", "]", "[[", "'3", "sa4", "ss$", "c$1", "u^x]", "^0'2$9", "r", "d"
+    };
+
+    RuleSet ruleset;
+    for (const auto& rule : rules) {
+        ASSERT_TRUE(ruleset.AddRule(rule));
+    }
+    EXPECT_FALSE(ruleset.IsLaneRule(rules.size() - 1));
+    EXPECT_FALSE(ruleset.IsLaneRule(rules.size() - 2));
+
+    TransposedBuffer<16> base;
+    for (size_t lane = 0; lane < words.size(); lane++) {
+        base.Set(lane, words[lane]);
+    }
+
+    for (size_t rule = 0; rule < rules.size() - 2; rule++) {
+        ASSERT_TRUE(ruleset.IsLaneRule(rule)) << rules[rule];
+        TransposedBuffer<16> candidates;
+        candidates.CopyFrom(base);
+        ruleset.ApplyLanes(rule, candidates);
+        for (size_t lane = 0; lane < words.size(); lane++) {
+            std::string expected(16, '\0');
+            expected.resize(ruleset.Apply(rule, words[lane], expected));
+            std::string actual(16, '\0');
+            actual.resize(candidates.Get(lane, actual));
+            EXPECT_EQ(actual, expected) << rules[rule] << " on \"" << words[lane] << "\"";
+        }
+    }
+}
@@ -223,4 +223,131 @@ TEST(WordGenerator, EqualityReversed) {
         EXPECT_EQ(value, WordGenerator::ParseReversed(word, LOWER));
         EXPECT_EQ(value, WordGenerator::ParseReversed(word, lut));
     }
-}
\ No newline at end of file
+}
+
+TEST(WordOdometer, MatchesGenerateWord) {
+    WordOdometer odometer(LOWER);
+    std::string buffer(16, ' ');
+    for (uint64_t value = 0; value < 30000; value++) {
+        auto length = odometer.Next(std::span<char>(buffer));
+        EXPECT_EQ(buffer.substr(0, length), WordGenerator::GenerateWord(value, LOWER));
+    }
+}
+
+// LOWER[701] = zz
+// LOWER[702] = aaa
+TEST(WordOdometer, SeekAndCarry) {
+    WordOdometer odometer(LOWER);
+    std::string buffer(16, ' ');
+    odometer.Seek(uint64_t(701));
+    EXPECT_EQ(odometer.Get(), "zz");
+    auto length = odometer.Next(std::span<char>(buffer));
+    EXPECT_EQ(buffer.substr(0, length), "zz");
+    EXPECT_EQ(odometer.Get(), "aaa");
+    odometer.Seek(mpz_class(26));
+    EXPECT_EQ(odometer.Get(), "aa");
+}
+
+TEST(WordOdometer, SeekBigValue) {
+    WordOdometer odometer(ASCII);
+    const mpz_class value("123456789012345678901234567890");
+    odometer.Seek(value);
+    std::string buffer(32, ' ');
+    for (size_t i = 0; i < 1000; i++) {
+        auto length = odometer.Next(std::span<char>(buffer));
+        EXPECT_EQ(buffer.substr(0, length), WordGenerator::GenerateWord(mpz_class(value + i), ASCII));
+    }
+}
+
+TEST(WordOdometer, PrefixPostfix) {
+    WordOdometer odometer(NUMERIC, "pre", "post");
+    std::string buffer(16, ' ');
+    odometer.Seek(uint64_t(9));
+    EXPECT_EQ(odometer.Get(), "pre9post");
+    odometer.Next(std::span<char>(buffer));
+    EXPECT_EQ(odometer.Get(), "pre00post");
+}
+
+TEST(WordOdometer, Truncates) {
+    WordOdometer odometer(LOWER, "prefix");
+    std::string buffer(4, ' ');
+    EXPECT_EQ(odometer.Next(std::span<char>(buffer)), 4);
+    EXPECT_EQ(buffer, "pref");
+}
+
+TEST(Mask, Parse) {
+    std::vector<std::string> custom = { "?dabc" };
+    auto mask = Mask::Parse("?u?l?1x??", custom);
+    ASSERT_TRUE(mask.has_value());
+    EXPECT_EQ(mask->GetLength(), 5);
+    EXPECT_EQ(mask->GetCharset(0), UPPER);
+    EXPECT_EQ(mask->GetCharset(1), LOWER);
+    EXPECT_EQ(mask->GetCharset(2), NUMERIC + "abc");
+    EXPECT_EQ(mask->GetCharset(3), "x");
+    EXPECT_EQ(mask->GetCharset(4), "?");
+    EXPECT_EQ(mask->Keyspace(5), mpz_class(26 * 26 * 13));
+    EXPECT_FALSE(Mask::Parse("?l?").has_value());
+    EXPECT_FALSE(Mask::Parse("?1").has_value());
+    EXPECT_FALSE(Mask::Parse("?z").has_value());
+}
+
+TEST(Mask, ParseLine) {
+    std::vector<std::string> custom = { "xy" };
+    auto mask = Mask::ParseLine("?1?d", custom);
+    ASSERT_TRUE(mask.has_value());
+    EXPECT_EQ(mask->GetCharset(0), "xy");
+    mask = Mask::ParseLine("?u?l,?d\\,,?1?2?l", custom);
+    ASSERT_TRUE(mask.has_value());
+    EXPECT_EQ(mask->GetLength(), 3);
+    EXPECT_EQ(mask->GetCharset(0), UPPER + LOWER);
+    EXPECT_EQ(mask->GetCharset(1), NUMERIC + ",");
+    EXPECT_EQ(mask->GetPattern(), "?1?2?l");
+    mask = Mask::ParseLine("a\\,b");
+    ASSERT_TRUE(mask.has_value());
+    EXPECT_EQ(mask->GetLength(), 3);
+    EXPECT_EQ(mask->GetCharset(1), ",");
+    EXPECT_FALSE(Mask::ParseLine("a,b,c,d,e,?l").has_value());
+    EXPECT_FALSE(Mask::ParseLine(",?1").has_value());
+}
+
+TEST(MaskOdometer, MixedRadix) {
+    auto mask = Mask::Parse("?d?u?l");
+    ASSERT_TRUE(mask.has_value());
+    MaskOdometer odometer(*mask);
+    std::string buffer(8, ' ');
+    std::vector<std::string> words;
+    for (size_t i = 0; i < 10 + 260 + 6760; i++) {
+        auto length = odometer.Next(std::span<char>(buffer));
+        words.push_back(buffer.substr(0, length));
+    }
+    EXPECT_EQ(words[0], "0");
+    EXPECT_EQ(words[9], "9");
+    EXPECT_EQ(words[10], "0A");
+    EXPECT_EQ(words[11], "1A");
+    EXPECT_EQ(words[269], "9Z");
+    EXPECT_EQ(words[270], "0Aa");
+    EXPECT_EQ(words.back(), "9Zz");
+    for (size_t i = 0; i < words.size(); i += 97) {
+        EXPECT_EQ(mask->Index(words[i]), mpz_class(i));
+    }
+}
+
+TEST(MaskOdometer, Seek) {
+    auto mask = Mask::Parse("?a?a?a?a?a?a?a?a?a?a?a?a?a?a?a?a?a?a?a?a?a?a");
+    ASSERT_TRUE(mask.has_value());
+    MaskOdometer reference(*mask);
+    MaskOdometer odometer(*mask);
+    const mpz_class start = mask->LengthIndex(3) - 5;
+    reference.Seek(start);
+    for (size_t i = 0; i < 20; i++) {
+        odometer.Seek(uint64_t(start.get_ui() + i));
+        EXPECT_EQ(odometer.Get(), reference.Get());
+        odometer.Seek((unsigned __int128)(start.get_ui() + i));
+        EXPECT_EQ(odometer.Get(), reference.Get());
+        std::string buffer(32, ' ');
+        reference.Next(std::span<char>(buffer));
+    }
+    const mpz_class big = mask->LengthIndex(22) + 12345;
+    odometer.Seek(big);
+    EXPECT_EQ(mask->Index(odometer.Get()), big);
+}